@@ -5,12 +5,19 @@
 #include <inttypes.h>
 #include <time.h>
 #include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <float.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <unistd.h>
 
 /* Compare for qsort */
 int compare_ints(const void *a, const void *b) {
     int ai = *(const int *)a;
     int bi = *(const int *)b;
-    return ai - bi;
+    return (ai > bi) - (ai < bi);
 }
 
 /* Merge two sorted halves */
@@ -29,6 +36,60 @@ int is_sorted(const int *arr, int64_t n) {
     return 1;
 }
 
+/* Key checksum: order-independent, so equal before and after the sort
+   unless keys were lost, duplicated or altered. The mixed sum catches
+   changes that cancel out in sum and xor. */
+typedef struct {
+    uint64_t count, sum, xr, mix;
+} key_sum;
+
+static inline uint64_t key_mix(int key) {
+    uint64_t z = (uint64_t)(uint32_t)key + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Checksum of the keys held by all ranks (collective) */
+static key_sum key_sum_all(const int *arr, int64_t n) {
+    uint64_t part[3] = { (uint64_t)n, 0, 0 }, tot[3];
+    uint64_t xr = 0, all_xr;
+    for (int64_t i = 0; i < n; i++) {
+        part[1] += (uint64_t)(int64_t)arr[i];
+        part[2] += key_mix(arr[i]);
+        xr      ^= (uint64_t)(uint32_t)arr[i];
+    }
+    MPI_Allreduce(part, tot, 3, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(&xr, &all_xr, 1, MPI_UINT64_T, MPI_BXOR, MPI_COMM_WORLD);
+
+    key_sum ks = { tot[0], tot[1], all_xr, tot[2] };
+    return ks;
+}
+
+static int key_sum_equal(key_sum a, key_sum b) {
+    return a.count == b.count && a.sum == b.sum && a.xr == b.xr && a.mix == b.mix;
+}
+
+/* Distributed order check (collective, same answer on every rank):
+   each rank checks its slice and compares its first key with the
+   largest last key of the ranks before it (an exclusive max-scan, so
+   empty slices are skipped) */
+static int is_sorted_all(const int *arr, int64_t n) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    int ok = is_sorted(arr, n);
+
+    int last = (n > 0) ? arr[n - 1] : INT_MIN, prev = INT_MIN;
+    MPI_Exscan(&last, &prev, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if (rank > 0 && n > 0 && prev > arr[0])
+        ok = 0;
+
+    int all_ok;
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    return all_ok;
+}
+
 int is_power_of_two(int x) {
     return (x > 0) && ((x & (x - 1)) == 0);
 }
@@ -49,8 +110,859 @@ void make_quasi_sorted(int *arr, int64_t n, unsigned int seed) {
     }
 }
 
+/* Input pattern: random, quasi or desc */
+static void generate_keys(int *arr, int64_t n, const char *pattern, unsigned int seed) {
+    if (strcmp(pattern, "quasi") == 0) {
+        make_quasi_sorted(arr, n, seed);
+    }
+    else if (strcmp(pattern, "desc") == 0) {
+        for (int64_t i = 0; i < n; i++)
+            arr[i] = (int)(n - 1 - i);
+    }
+    else {  /* random */
+        srand(seed);
+        for (int64_t i = 0; i < n; i++)
+            arr[i] = rand() % 100000;
+    }
+}
+
+/* Aligned buffers: 64-byte aligned; with --hugepages, buffers of at
+   least one huge page are 2 MB aligned and advised for transparent
+   huge pages (4 KB pages if THP is off) */
+#define HUGE_PAGE ((size_t)2 << 20)
+
+static int hugepages = 0;
+static int hugepages_denied = 0;
+
+static void *buf_alloc(size_t nbytes) {
+    int huge = hugepages && nbytes >= HUGE_PAGE;
+    size_t align = huge ? HUGE_PAGE : 64;
+    size_t len = (nbytes + align - 1) / align * align;
+    if (len == 0) len = align;
+
+    void *p = NULL;
+    if (posix_memalign(&p, align, len) != 0)
+        return NULL;
+
+    if (huge && madvise(p, len, MADV_HUGEPAGE) != 0)
+        hugepages_denied = 1;
+    return p;
+}
+
+/* One write per page, so first-touch faults stay out of timed regions */
+static void buf_prefault(void *p, size_t nbytes) {
+    volatile char *c = p;
+    for (size_t i = 0; i < nbytes; i += 4096)
+        c[i] = 0;
+}
+
+static const char *page_mode(void) {
+    if (!hugepages) return "4k";
+
+    FILE *fp = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (fp) {
+        char line[128] = "";
+        if (fgets(line, sizeof(line), fp) && strstr(line, "[never]"))
+            hugepages_denied = 1;
+        fclose(fp);
+    }
+    return hugepages_denied ? "4k (huge pages unavailable)" : "huge";
+}
+
+/* Benchmark harness: statistics over --reps timed runs (after
+   --warmup untimed ones) and the unified results.csv row */
+#ifndef GIT_HASH
+#define GIT_HASH "unknown"
+#endif
+#ifndef BUILD_FLAGS
+#define BUILD_FLAGS "unknown"
+#endif
+
+#define RESULTS_CSV "results.csv"
+
+typedef struct {
+    double min, median, p95, stddev;
+} bench_stats;
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Summary of r timings (sorted in place); p95 is the nearest rank */
+static bench_stats bench_summary(double *t, int r) {
+    qsort(t, (size_t)r, sizeof(double), compare_doubles);
+
+    double mean = 0.0, var = 0.0;
+    for (int i = 0; i < r; i++) mean += t[i];
+    mean /= r;
+    for (int i = 0; i < r; i++) var += (t[i] - mean) * (t[i] - mean);
+
+    bench_stats s;
+    s.min    = t[0];
+    s.median = (r % 2) ? t[r / 2] : 0.5 * (t[r / 2 - 1] + t[r / 2]);
+    s.p95    = t[(int)ceil(0.95 * r) - 1];
+    s.stddev = (r > 1) ? sqrt(var / (r - 1)) : 0.0;
+    return s;
+}
+
+/* Median time plus spread and throughput on stdout */
+static void print_stats(int64_t n, int warmup, int reps, bench_stats s) {
+    double rate = (s.median > 0.0) ? (double)n / s.median : 0.0;
+
+    printf("time = %.6f s\n", s.median);
+    if (reps > 1)
+        printf("reps = %d (+%d warmup): min %.6f s, p95 %.6f s, stddev %.6f s\n",
+               reps, warmup, s.min, s.p95, s.stddev);
+    printf("rate = %.0f keys/s, %.1f MB/s\n", rate, rate * sizeof(int) / 1e6);
+}
+
+/* "model name" from /proc/cpuinfo */
+static void cpu_model(char *buf, size_t len) {
+    snprintf(buf, len, "unknown");
+
+    FILE *fp = fopen("/proc/cpuinfo", "r");
+    if (!fp) return;
+
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        char *v = strchr(line, ':');
+        if (strncmp(line, "model name", 10) == 0 && v) {
+            v += 1 + strspn(v + 1, " \t");
+            v[strcspn(v, "\n")] = '\0';
+            snprintf(buf, len, "%s", v);
+            break;
+        }
+    }
+    fclose(fp);
+}
+
+static void csv_quoted(FILE *fp, const char *s) {
+    fputc('"', fp);
+    for (; *s; s++) {
+        if (*s == '"') fputc('"', fp);
+        fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+/* One row of results.csv, the file shared by all five programs;
+   program-specific settings go to params as key=value;key=value */
+static void write_result(const char *program, int64_t n, const char *pattern,
+                         int threads, int processes, int warmup, int reps,
+                         bench_stats s, int ok, const char *params) {
+    FILE *fp = fopen(RESULTS_CSV, "a");
+    if (!fp) {
+        fprintf(stderr, "Error opening %s\n", RESULTS_CSV);
+        return;
+    }
+
+    if (ftell(fp) == 0)
+        fprintf(fp, "program,n,pattern,threads,processes,warmup,reps,"
+                    "min,median,p95,stddev,keys_per_s,bytes_per_s,sorted,"
+                    "params,git,compiler,flags,cpu\n");
+
+    double rate = (s.median > 0.0) ? (double)n / s.median : 0.0;
+    char cpu[256];
+    cpu_model(cpu, sizeof(cpu));
+
+    fprintf(fp, "%s,%" PRId64 ",%s,%d,%d,%d,%d,%.6f,%.6f,%.6f,%.6f,%.0f,%.0f,%s,",
+            program, n, pattern, threads, processes, warmup, reps,
+            s.min, s.median, s.p95, s.stddev, rate, rate * sizeof(int),
+            ok ? "yes" : "no");
+    csv_quoted(fp, params);
+    fputc(',', fp);
+    csv_quoted(fp, GIT_HASH);
+    fputc(',', fp);
+    csv_quoted(fp, __VERSION__);
+    fputc(',', fp);
+    csv_quoted(fp, BUILD_FLAGS);
+    fputc(',', fp);
+    csv_quoted(fp, cpu);
+    fputc('\n', fp);
+
+    fclose(fp);
+}
+
+/* Phase timers: named spans of a run, accumulated per rank and reported
+   on rank 0 as min/avg/max over ranks. With --perf every span also reads
+   cycles, LLC misses and branch misses (perf_event, user space only). */
+enum { PH_GENERATE, PH_SCATTER, PH_LOCAL_SORT, PH_EXCHANGE, PH_MERGE,
+       PH_GATHER, PH_CHECKPOINT, PH_VERIFY, PH_COUNT };
+
+static const char *phase_name[PH_COUNT] = {
+    "generate", "scatter", "local sort", "exchange", "merge", "gather",
+    "checkpoint", "verify"
+};
+
+#define PERF_COUNT 3
+static const char *perf_name[PERF_COUNT] = { "cycles", "llc-miss", "br-miss" };
+static int perf_fd[PERF_COUNT] = { -1, -1, -1 };
+
+static double   phase_time[PH_COUNT];
+static double   phase_t0[PH_COUNT];
+static int      phase_used[PH_COUNT];
+static uint64_t phase_ctr[PH_COUNT][PERF_COUNT];
+static uint64_t phase_c0[PH_COUNT][PERF_COUNT];
+
+/* 1/reps inside timed repetitions and 0 in warmups, so spans that repeat
+   are reported per run */
+static double phase_weight = 1.0;
+
+/* Returns how many counters could be opened (0 without PMU access) */
+static int perf_open(void) {
+    static const uint64_t config[PERF_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    int opened = 0;
+
+    for (int i = 0; i < PERF_COUNT; i++) {
+        struct perf_event_attr a;
+        memset(&a, 0, sizeof(a));
+        a.size = sizeof(a);
+        a.type = PERF_TYPE_HARDWARE;
+        a.config = config[i];
+        a.exclude_kernel = 1;
+        a.exclude_hv = 1;
+
+        perf_fd[i] = (int)syscall(__NR_perf_event_open, &a, 0, -1, -1, 0);
+        opened += (perf_fd[i] >= 0);
+    }
+    return opened;
+}
+
+static void perf_read(uint64_t *v) {
+    for (int i = 0; i < PERF_COUNT; i++)
+        if (perf_fd[i] < 0 || read(perf_fd[i], &v[i], sizeof(v[i])) != sizeof(v[i]))
+            v[i] = 0;
+}
+
+static void phase_begin(int ph) {
+    perf_read(phase_c0[ph]);
+    phase_t0[ph] = MPI_Wtime();
+}
+
+static void phase_end(int ph) {
+    double t = MPI_Wtime();
+    uint64_t c[PERF_COUNT];
+    perf_read(c);
+
+    phase_used[ph] = 1;
+    phase_time[ph] += (t - phase_t0[ph]) * phase_weight;
+    for (int i = 0; i < PERF_COUNT; i++)
+        phase_ctr[ph][i] += (uint64_t)((double)(c[i] - phase_c0[ph][i]) * phase_weight);
+}
+
+/* Collective: rank 0 prints one line per phase, with min/avg/max over
+   the ranks that entered it; counters are summed over ranks */
+static void phase_report(int perf) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    double mine[PH_COUNT], tmin[PH_COUNT], tmax[PH_COUNT], tsum[PH_COUNT];
+    int used[PH_COUNT];
+    uint64_t ctr[PH_COUNT][PERF_COUNT];
+    int have = 0, open = (perf_fd[0] >= 0) + (perf_fd[1] >= 0) + (perf_fd[2] >= 0);
+
+    for (int ph = 0; ph < PH_COUNT; ph++)
+        mine[ph] = phase_used[ph] ? phase_time[ph] : DBL_MAX;
+
+    MPI_Reduce(mine, tmin, PH_COUNT, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+    MPI_Reduce(phase_time, tmax, PH_COUNT, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(phase_time, tsum, PH_COUNT, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(phase_used, used, PH_COUNT, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(phase_ctr, ctr, PH_COUNT * PERF_COUNT, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&open, &have, 1, MPI_INT, MPI_MIN, 0, MPI_COMM_WORLD);
+
+    if (rank != 0) return;
+
+    printf("phases (s, min/avg/max over ranks):\n");
+    for (int ph = 0; ph < PH_COUNT; ph++) {
+        if (!used[ph]) continue;
+        printf("  %-10s %.6f %.6f %.6f (%d rank%s)", phase_name[ph],
+               tmin[ph], tsum[ph] / used[ph], tmax[ph],
+               used[ph], used[ph] > 1 ? "s" : "");
+        if (perf && have)
+            for (int i = 0; i < PERF_COUNT; i++)
+                if (perf_fd[i] >= 0)
+                    printf("  %s %.3e", perf_name[i], (double)ctr[ph][i]);
+        printf("\n");
+    }
+    if (perf && !have)
+        printf("  perf counters unavailable (perf_event_open failed)\n");
+}
+
+/* Command-line options (--name=value); positional args are moved first */
+static int split_args(int argc, char **argv) {
+    int k = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            char *tmp = argv[i];
+            memmove(&argv[k + 1], &argv[k], (size_t)(i - k) * sizeof(char *));
+            argv[k++] = tmp;
+        }
+    }
+    return k;
+}
+
+static const char *get_opt(int argc, char **argv, const char *name) {
+    size_t len = strlen(name);
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) continue;
+        if (strncmp(argv[i] + 2, name, len) != 0) continue;
+        if (argv[i][2 + len] == '=') return argv[i] + 3 + len;
+        if (argv[i][2 + len] == '\0') return "";
+    }
+    return NULL;
+}
+
+/* Collective read of this rank's slice [first, first + count) of a raw
+   int32 key file holding at least n keys */
+static void read_keys_all(const char *path, int *buf, int count,
+                          int64_t first, int64_t n) {
+    MPI_File fh;
+    if (MPI_File_open(MPI_COMM_WORLD, path, MPI_MODE_RDONLY,
+                      MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        fprintf(stderr, "Error opening %s\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    MPI_Offset fsize;
+    MPI_File_get_size(fh, &fsize);
+    if (fsize < (MPI_Offset)(n * (int64_t)sizeof(int))) {
+        fprintf(stderr, "Error: %s holds fewer than %" PRId64 " keys\n", path, n);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    MPI_File_read_at_all(fh, (MPI_Offset)(first * (int64_t)sizeof(int)),
+                         buf, count, MPI_INT, MPI_STATUS_IGNORE);
+    MPI_File_close(&fh);
+}
+
+/* Collective write: every rank appends its count keys at the offset
+   given by the exclusive prefix sum of the counts in rank order */
+static void write_keys_all(const char *path, const int *buf, int count) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    int64_t mine = count, first = 0;
+    MPI_Exscan(&mine, &first, 1, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) first = 0;
+
+    MPI_File fh;
+    if (MPI_File_open(MPI_COMM_WORLD, path,
+                      MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        fprintf(stderr, "Error opening %s\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    MPI_File_set_size(fh, 0);
+    MPI_File_write_at_all(fh, (MPI_Offset)(first * (int64_t)sizeof(int)),
+                          buf, count, MPI_INT, MPI_STATUS_IGNORE);
+    MPI_File_close(&fh);
+}
+
+/* Checkpoint / restart (--checkpoint=DIR, --restart). At phase
+   boundaries every rank writes the keys it holds with collective MPI-IO
+   to DIR/<program>.ckpt: a header (rank 0), the per-rank counts, then
+   the keys in rank order. Each checkpoint goes to a .tmp file that rank
+   0 renames once all ranks have synced and closed it, so the named file
+   always holds the last complete phase. --restart reads it back and the
+   sort resumes after that phase. */
+#define CKPT_MAGIC 0x54504b43u   /* "CKPT" */
+
+typedef struct {
+    uint32_t magic;
+    int32_t  procs;
+    int64_t  n;
+    int32_t  done;               /* phases completed */
+    char     pattern[20];
+    key_sum  in_sum;             /* input checksum, verified after restart */
+} ckpt_header;
+
+static struct {
+    const char *dir;             /* NULL: checkpoints off */
+    const char *program;
+    const char *pattern;
+    int64_t     n;
+    key_sum     in_sum;
+    int         fail_after;      /* --fail-after: abort after this phase */
+    int         writes;
+    int64_t     bytes;           /* this rank, all writes */
+    double      time;            /* this rank, all writes */
+} ckpt;
+
+static void ckpt_path(char *path, size_t len, const char *suffix) {
+    snprintf(path, len, "%s/%s.ckpt%s", ckpt.dir, ckpt.program, suffix);
+}
+
+/* --checkpoint=DIR, --restart and --fail-after=P (simulated failure:
+   abort once phase P of nphases is checkpointed); 0 if they are misused */
+static int ckpt_options(int argc, char **argv, const char *program, int nphases,
+                        int *restart) {
+    const char *opt;
+    ckpt.dir        = get_opt(argc, argv, "checkpoint");
+    ckpt.program    = program;
+    ckpt.fail_after = (opt = get_opt(argc, argv, "fail-after")) != NULL ? atoi(opt) : 0;
+    *restart        = (get_opt(argc, argv, "restart") != NULL);
+
+    if (ckpt.fail_after < 0 || ckpt.fail_after > nphases)
+        return 0;
+    if (ckpt.dir)
+        return *ckpt.dir != '\0';
+    return !*restart && ckpt.fail_after == 0;
+}
+
+/* Collective; no-op without --checkpoint. done counts the phases
+   completed, keys are the count keys this rank holds after them. */
+static void ckpt_save(int done, const int *keys, int count) {
+    if (!ckpt.dir)
+        return;
+
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    phase_begin(PH_CHECKPOINT);
+    double t0 = MPI_Wtime();
+
+    int64_t mine = count, first = 0;
+    MPI_Exscan(&mine, &first, 1, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) first = 0;
+
+    char tmp[512], path[512];
+    ckpt_path(tmp, sizeof(tmp), ".tmp");
+    ckpt_path(path, sizeof(path), "");
+
+    MPI_File fh;
+    if (MPI_File_open(MPI_COMM_WORLD, tmp, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        if (rank == 0) fprintf(stderr, "Error opening %s\n", tmp);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_set_size(fh, 0);
+
+    ckpt_header h;
+    memset(&h, 0, sizeof(h));
+    h.magic  = CKPT_MAGIC;
+    h.procs  = size;
+    h.n      = ckpt.n;
+    h.done   = done;
+    h.in_sum = ckpt.in_sum;
+    snprintf(h.pattern, sizeof(h.pattern), "%s", ckpt.pattern);
+
+    MPI_Offset keys_at = (MPI_Offset)sizeof(h) + (MPI_Offset)size * sizeof(int64_t);
+    MPI_File_write_at_all(fh, 0, &h, (rank == 0) ? (int)sizeof(h) : 0, MPI_BYTE,
+                          MPI_STATUS_IGNORE);
+    MPI_File_write_at_all(fh, (MPI_Offset)sizeof(h) + (MPI_Offset)rank * sizeof(int64_t),
+                          &mine, 1, MPI_INT64_T, MPI_STATUS_IGNORE);
+    MPI_File_write_at_all(fh, keys_at + (MPI_Offset)(first * (int64_t)sizeof(int)),
+                          keys, count, MPI_INT, MPI_STATUS_IGNORE);
+    MPI_File_sync(fh);
+    MPI_File_close(&fh);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (rank == 0 && rename(tmp, path) != 0) {
+        fprintf(stderr, "Error renaming %s\n", tmp);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    ckpt.time  += MPI_Wtime() - t0;
+    ckpt.bytes += (int64_t)count * (int64_t)sizeof(int);
+    ckpt.writes++;
+    phase_end(PH_CHECKPOINT);
+
+    if (done == ckpt.fail_after) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (rank == 0)
+            fprintf(stderr, "Simulated failure after phase %d\n", done);
+        MPI_Abort(MPI_COMM_WORLD, 2);
+    }
+}
+
+/* Collective: loads this rank's keys from the last checkpoint into
+   *buf (grown, never shrunk, to *cap keys) and returns the phases it
+   completed, or 0 when there is no usable checkpoint for this n and
+   process count. *count, ckpt.in_sum and pattern are filled on success. */
+static int ckpt_restore(int **buf, int *cap, int *count, char *pattern, size_t plen) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    char path[512];
+    ckpt_path(path, sizeof(path), "");
+
+    MPI_File fh;
+    if (MPI_File_open(MPI_COMM_WORLD, path, MPI_MODE_RDONLY,
+                      MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        if (rank == 0) fprintf(stderr, "No checkpoint at %s, starting over\n", path);
+        return 0;
+    }
+
+    ckpt_header h;
+    MPI_File_read_at_all(fh, 0, &h, (int)sizeof(h), MPI_BYTE, MPI_STATUS_IGNORE);
+    if (h.magic != CKPT_MAGIC || h.procs != size || h.n != ckpt.n || h.done < 1) {
+        if (rank == 0)
+            fprintf(stderr, "Checkpoint %s is for another run (n = %" PRId64
+                    ", %d processes), starting over\n", path, h.n, h.procs);
+        MPI_File_close(&fh);
+        return 0;
+    }
+
+    int64_t mine, first = 0;
+    MPI_File_read_at_all(fh, (MPI_Offset)sizeof(h) + (MPI_Offset)rank * sizeof(int64_t),
+                         &mine, 1, MPI_INT64_T, MPI_STATUS_IGNORE);
+    MPI_Exscan(&mine, &first, 1, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) first = 0;
+
+    if (mine > *cap) {
+        free(*buf);
+        *buf = buf_alloc((size_t)mine * sizeof(int));
+        if (!*buf) {
+            fprintf(stderr, "rank %d: allocation failed\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        *cap = (int)mine;
+    }
+
+    MPI_Offset keys_at = (MPI_Offset)sizeof(h) + (MPI_Offset)size * sizeof(int64_t);
+    MPI_File_read_at_all(fh, keys_at + (MPI_Offset)(first * (int64_t)sizeof(int)),
+                         *buf, (int)mine, MPI_INT, MPI_STATUS_IGNORE);
+    MPI_File_close(&fh);
+
+    *count = (int)mine;
+    ckpt.in_sum = h.in_sum;
+    snprintf(pattern, plen, "%s", h.pattern);
+    return h.done;
+}
+
+/* Checkpoint cost on rank 0: writes and volume per run, slowest rank's
+   write time per run and its share of the sort time, plus the phase a
+   restart resumed after (collective) */
+static void ckpt_report(int runs, double t_sort, int done, char *params, size_t plen) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    double t_max;
+    int64_t bytes;
+    MPI_Reduce(&ckpt.time, &t_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&ckpt.bytes, &bytes, 1, MPI_INT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank != 0)
+        return;
+
+    double per_run = t_max / runs;
+    printf("checkpoint = %d writes/run, %.1f MB/run, %.6f s/run (%.1f%% of time)\n",
+           ckpt.writes / runs, (double)bytes / runs / 1e6, per_run,
+           (t_sort > 0.0) ? 100.0 * per_run / t_sort : 0.0);
+    if (done)
+        printf("restart = resumed after phase %d\n", done);
+    snprintf(params, plen, "ckpt=%d;ckpt_s=%.6f;restart=%d",
+             ckpt.writes / runs, per_run, done);
+}
+
+/* Local sort, then the bitonic merge network over the ranks; recv_buf
+   holds local_n keys and merged 2 * local_n. Phases are numbered from 1
+   (the local sort, then every compare-split stage) and each one is
+   checkpointed; the first done phases are skipped (restart). */
+static void bitonic_sort(int *local_arr, int local_n, int *recv_buf, int *merged,
+                         int done) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    if (done < 1) {
+        phase_begin(PH_LOCAL_SORT);
+        qsort(local_arr, local_n, sizeof(int), compare_ints);
+        phase_end(PH_LOCAL_SORT);
+        ckpt_save(1, local_arr, local_n);
+    }
+
+    /* Bitonic merge phases */
+    int phase = 1;
+    for (int k = 2; k <= size; k <<= 1) {
+        for (int j = k >> 1; j > 0; j >>= 1) {
+
+            if (++phase <= done)
+                continue;
+
+            int partner = rank ^ j;
+
+            phase_begin(PH_EXCHANGE);
+            MPI_Sendrecv(local_arr, local_n, MPI_INT, partner, 0,
+                         recv_buf,  local_n, MPI_INT, partner, 0,
+                         MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            phase_end(PH_EXCHANGE);
+
+            phase_begin(PH_MERGE);
+            merge_two(local_arr, local_n, recv_buf, local_n, merged);
+
+            int up  = ((rank & k) == 0);
+            int low = ((rank & j) == 0);
+
+            int keep_low = (up && low) || (!up && !low);
+
+            if (keep_low) {
+                for (int i = 0; i < local_n; i++)
+                    local_arr[i] = merged[i];
+            } else {
+                for (int i = 0; i < local_n; i++)
+                    local_arr[i] = merged[i + local_n];
+            }
+            phase_end(PH_MERGE);
+
+            ckpt_save(phase, local_arr, local_n);
+        }
+    }
+}
+
+/* Service mode (--serve): MPI, the ranks and their buffers stay up
+   across many sorts. Rank 0 reads jobs one per line from a job file, or
+   from stdin with --serve=- (a FIFO then keeps the service up between
+   clients), and broadcasts each line:
+
+       <n> [pattern] [seed] [--input=keys.bin]
+
+   Blank lines and lines starting with # are skipped; "quit" or end of
+   input stops the service. Startup (MPI_Init, first contact between
+   every pair of ranks) is reported once; every job reports its latency,
+   from reading the line to the verified result, and the sort time
+   inside it (slowest rank for both). */
+#define JOB_LINE 512
+#define JOB_ARGS 16
+
+/* Grow-only key buffer, faulted in when it grows, so a job no larger
+   than an earlier one touches no new pages */
+typedef struct {
+    int    *p;
+    int64_t cap;
+} key_arena;
+
+static int *arena_reserve(key_arena *a, int64_t n) {
+    if (n <= a->cap)
+        return a->p;
+    free(a->p);
+    a->cap = 0;
+    if (!(a->p = buf_alloc((size_t)(n > 0 ? n : 1) * sizeof(int)))) {
+        fprintf(stderr, "arena: allocation of %" PRId64 " keys failed\n", n);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    buf_prefault(a->p, (size_t)n * sizeof(int));
+    a->cap = n;
+    return a->p;
+}
+
+/* Next job line on every rank; "quit" at end of input */
+static void read_job(FILE *jobs, char *line) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0 && !fgets(line, JOB_LINE, jobs))
+        strcpy(line, "quit");
+    MPI_Bcast(line, JOB_LINE, MPI_CHAR, 0, MPI_COMM_WORLD);
+}
+
+/* Splits a job line in place into argv form (jargv[0] is a placeholder) */
+static int job_args(char *line, char **jargv) {
+    static char name[] = "job";
+    int jc = 0;
+    jargv[jc++] = name;
+    for (char *tok = strtok(line, " \t\r\n"); tok && jc < JOB_ARGS;
+         tok = strtok(NULL, " \t\r\n"))
+        jargv[jc++] = tok;
+    return jc;
+}
+
+/* Rank 0 checks that an input file holds n keys, so a bad job is
+   skipped instead of aborting the service */
+static int input_holds(const char *path, int64_t n) {
+    int rank, ok = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0) {
+        FILE *fp = fopen(path, "rb");
+        ok = fp && fseek(fp, 0, SEEK_END) == 0 &&
+             ftell(fp) >= (long)(n * (int64_t)sizeof(int));
+        if (fp) fclose(fp);
+        if (!ok)
+            fprintf(stderr, "Error: %s missing or holds fewer than %" PRId64 " keys\n",
+                    path, n);
+    }
+    MPI_Bcast(&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return ok;
+}
+
+/* One-time startup: time since launch on the slowest rank, after an
+   all-to-all so every pair of ranks has made first contact */
+static double serve_startup(const struct timespec *t_launch) {
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    int *a = calloc((size_t)size, sizeof(int));
+    int *b = calloc((size_t)size, sizeof(int));
+    MPI_Alltoall(a, 1, MPI_INT, b, 1, MPI_INT, MPI_COMM_WORLD);
+    free(a);
+    free(b);
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    double mine = (double)(t.tv_sec - t_launch->tv_sec) +
+                  (double)(t.tv_nsec - t_launch->tv_nsec) * 1e-9, all;
+    MPI_Allreduce(&mine, &all, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    return all;
+}
+
+/* Per-job line and results.csv row (rank 0): the timing columns hold
+   the sort, params the job number, startup and latency */
+static void report_job(const char *program, int job, int64_t n,
+                       const char *pattern, int size, double startup,
+                       double latency, double t_sort, int ok) {
+    printf("job %d: n = %" PRId64 ", pattern = %s, latency = %.6f s, "
+           "sort = %.6f s, sorted = %s\n",
+           job, n, pattern, latency, t_sort, ok ? "yes" : "no");
+    fflush(stdout);
+
+    char params[128];
+    snprintf(params, sizeof(params), "mode=serve;job=%d;startup=%.6f;latency=%.6f%s",
+             job, startup, latency, hugepages ? ";pages=huge" : "");
+    write_result(program, n, pattern, 1, size, 0, 1, bench_summary(&t_sort, 1), ok, params);
+}
+
+static void serve_summary(double *lat, int done, int seen, int failed) {
+    if (done == 0)
+        return;
+    bench_stats st = bench_summary(lat, done);
+    printf("jobs = %d, failed = %d\n", seen, failed);
+    printf("latency = %.6f s median, %.6f s min, %.6f s p95\n\n",
+           st.median, st.min, st.p95);
+}
+
+static int serve_jobs(const char *path, const struct timespec *t_launch) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    FILE *jobs = NULL;
+    int opened = 1;
+    if (rank == 0) {
+        jobs = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+        opened = (jobs != NULL);
+        if (!opened)
+            fprintf(stderr, "Error opening %s\n", path);
+    }
+    MPI_Bcast(&opened, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (!opened)
+        return 1;
+
+    key_arena a_global = { NULL, 0 }, a_local = { NULL, 0 };
+    key_arena a_recv = { NULL, 0 }, a_merged = { NULL, 0 };
+
+    double startup = serve_startup(t_launch);
+    if (rank == 0) {
+        printf("MPI Bitonic Sort (service)\n");
+        printf("processes = %d\n", size);
+        printf("startup = %.6f s\n", startup);
+        fflush(stdout);
+    }
+
+    int cap = 64, seen = 0, done = 0, failed = 0;
+    double *lat = malloc((size_t)cap * sizeof(double));
+    char line[JOB_LINE];
+
+    for (;;) {
+        read_job(jobs, line);
+        /* latency starts once the line is in, not while waiting for it */
+        double t0 = MPI_Wtime();
+
+        char *jargv[JOB_ARGS];
+        int jc = job_args(line, jargv);
+        if (jc < 2 || jargv[1][0] == '#')
+            continue;
+        if (strcmp(jargv[1], "quit") == 0)
+            break;
+        seen++;
+
+        int npos = split_args(jc, jargv);
+        int64_t n = (npos >= 2) ? atoll(jargv[1]) : 0;
+        if (n <= 0 || n % size != 0 || n > INT_MAX) {
+            if (rank == 0)
+                fprintf(stderr, "job %d: n must be positive, at most %d and "
+                        "divisible by %d\n", seen, INT_MAX, size);
+            failed++;
+            continue;
+        }
+
+        const char *pattern = (npos >= 3) ? jargv[2] : "random";
+        unsigned int seed = (npos >= 4)
+                            ? (unsigned int)strtoul(jargv[3], NULL, 10)
+                            : (unsigned int)time(NULL);
+        const char *input = get_opt(jc, jargv, "input");
+        if (input && !input_holds(input, n)) {
+            failed++;
+            continue;
+        }
+
+        int local_n   = (int)(n / size);
+        int *local_arr = arena_reserve(&a_local, local_n);
+        int *recv_buf  = arena_reserve(&a_recv, local_n);
+        int *merged    = arena_reserve(&a_merged, 2 * (int64_t)local_n);
+
+        if (input) {
+            read_keys_all(input, local_arr, local_n, (int64_t)rank * local_n, n);
+            pattern = "file";
+        }
+        else {
+            int *global_arr = NULL;
+            if (rank == 0) {
+                global_arr = arena_reserve(&a_global, n);
+                generate_keys(global_arr, n, pattern, seed);
+            }
+            MPI_Scatter(global_arr, local_n, MPI_INT,
+                        local_arr, local_n, MPI_INT,
+                        0, MPI_COMM_WORLD);
+        }
+        key_sum in_sum = key_sum_all(local_arr, local_n);
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        double s0 = MPI_Wtime();
+        bitonic_sort(local_arr, local_n, recv_buf, merged, 0);
+        double t_sort = MPI_Wtime() - s0;
+
+        int ok = is_sorted_all(local_arr, local_n);
+        ok = key_sum_equal(in_sum, key_sum_all(local_arr, local_n)) && ok;
+
+        double t[2] = { MPI_Wtime() - t0, t_sort }, tmax[2];
+        MPI_Reduce(t, tmax, 2, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+        done++;
+        if (!ok)
+            failed++;
+        if (done == cap)
+            lat = realloc(lat, (size_t)(cap *= 2) * sizeof(double));
+        lat[done - 1] = tmax[0];
+
+        if (rank == 0)
+            report_job("mpi_bitonicsort", seen, n, pattern, size, startup,
+                       tmax[0], tmax[1], ok);
+    }
+
+    if (rank == 0) {
+        serve_summary(lat, done, seen, failed);
+        if (jobs != stdin)
+            fclose(jobs);
+    }
+
+    free(lat);
+    free(a_global.p);
+    free(a_local.p);
+    free(a_recv.p);
+    free(a_merged.p);
+    return 0;
+}
+
 int main(int argc, char **argv) {
 
+    struct timespec t_launch;
+    clock_gettime(CLOCK_MONOTONIC, &t_launch);
+
     MPI_Init(&argc, &argv);
 
     int rank, size;
@@ -58,11 +970,32 @@ int main(int argc, char **argv) {
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
     /* Args */
-    if (argc < 2) {
+    int npos = split_args(argc, argv);
+
+    /* Service mode: no positional arguments, jobs come from a file */
+    const char *serve = get_opt(argc, argv, "serve");
+    if (serve) {
+        if (!is_power_of_two(size)) {
+            if (rank == 0)
+                fprintf(stderr, "Error: number of processes must be power of two.\n");
+            MPI_Finalize();
+            return 1;
+        }
+        hugepages = (get_opt(argc, argv, "hugepages") != NULL);
+        int rc = serve_jobs(*serve ? serve : "-", &t_launch);
+        MPI_Finalize();
+        return rc;
+    }
+
+    if (npos < 2) {
         if (rank == 0)
             fprintf(stderr,
-                "Usage: %s <n> [pattern=random|quasi|desc] [seed]\n",
-                argv[0]);
+                "Usage: %s <n> [pattern=random|quasi|desc] [seed]"
+                " [--input=keys.bin] [--output=sorted.bin] [--hugepages]"
+                " [--warmup=W] [--reps=R] [--phases] [--perf]"
+                " [--checkpoint=DIR [--restart] [--fail-after=P]]\n"
+                "       %s --serve=jobs.txt|- [--hugepages]\n",
+                argv[0], argv[0]);
         MPI_Finalize();
         return 1;
     }
@@ -74,9 +1007,31 @@ int main(int argc, char **argv) {
         return 1;
     }
 
-    const char *pattern = (argc >= 3) ? argv[2] : "random";
+    const char *pattern = (npos >= 3) ? argv[2] : "random";
 
-    unsigned int seed = (argc >= 4)
+    const char *input  = get_opt(argc, argv, "input");
+    const char *output = get_opt(argc, argv, "output");
+    if (input) pattern = "file";
+
+    hugepages = (get_opt(argc, argv, "hugepages") != NULL);
+
+    /* W untimed warmup runs, then R timed repetitions on the same input */
+    const char *opt;
+    int warmup = (opt = get_opt(argc, argv, "warmup")) != NULL ? atoi(opt) : 0;
+    int reps   = (opt = get_opt(argc, argv, "reps"))   != NULL ? atoi(opt) : 1;
+    if (warmup < 0 || reps < 1) {
+        if (rank == 0) fprintf(stderr, "Error: --warmup must be >= 0 and --reps >= 1\n");
+        MPI_Finalize();
+        return 1;
+    }
+
+    /* Per-phase report; --perf adds hardware counters to it */
+    int perf   = (get_opt(argc, argv, "perf") != NULL);
+    int phases = perf || (get_opt(argc, argv, "phases") != NULL);
+    if (perf)
+        perf_open();
+
+    unsigned int seed = (npos >= 4)
                         ? (unsigned int)strtoul(argv[3], NULL, 10)
                         : (unsigned int)time(NULL);
 
@@ -94,112 +1049,165 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    /* Checkpoint after every phase; --restart resumes from the last one */
+    int levels = 0;
+    while ((1 << levels) < size) levels++;
+    int nphases = 1 + levels * (levels + 1) / 2;   /* local sort + stages */
+
+    int restart;
+    if (!ckpt_options(argc, argv, "mpi_bitonicsort", nphases, &restart)) {
+        if (rank == 0)
+            fprintf(stderr, "Error: --restart and --fail-after need --checkpoint=DIR,"
+                            " and --fail-after=P needs 1 <= P <= %d\n", nphases);
+        MPI_Finalize();
+        return 1;
+    }
+    ckpt.n = n;
+
     int local_n = n / size;
 
-    /* Global array (only rank 0) */
-    int *global_arr = NULL;
-    if (rank == 0) {
-        global_arr = malloc(n * sizeof(int));
+    /* Local buffer, exchange buffers (faulted in before the timer) */
+    int *local_arr = buf_alloc(local_n * sizeof(int));
+    int *recv_buf  = buf_alloc(local_n * sizeof(int));
+    int *merged    = buf_alloc(2 * local_n * sizeof(int));
+    if (!local_arr || !recv_buf || !merged) {
+        fprintf(stderr, "rank %d: allocation failed\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    buf_prefault(recv_buf, local_n * sizeof(int));
+    buf_prefault(merged, 2 * local_n * sizeof(int));
 
-        if (strcmp(pattern, "quasi") == 0) {
-            make_quasi_sorted(global_arr, n, seed);
-        }
-        else if (strcmp(pattern, "desc") == 0) {
-            for (int64_t i = 0; i < n; i++)
-                global_arr[i] = (int)(n - 1 - i);
-        }
-        else {  /* random */
-            srand(seed);
-            for (int64_t i = 0; i < n; i++)
-                global_arr[i] = rand() % 100000;
+    /* Restart: keys, pattern and input checksum from the checkpoint, one run */
+    int done = 0;
+    char ckpt_pattern[20];
+    if (restart) {
+        int cap = local_n, count;
+        done = ckpt_restore(&local_arr, &cap, &count, ckpt_pattern, sizeof(ckpt_pattern));
+        if (done) {
+            pattern = ckpt_pattern;
+            warmup  = 0;
+            reps    = 1;
         }
     }
 
-    /* Local buffer */
-    int *local_arr = malloc(local_n * sizeof(int));
+    double t_io = 0.0;
 
-    MPI_Scatter(global_arr, local_n, MPI_INT,
-                local_arr, local_n, MPI_INT,
-                0, MPI_COMM_WORLD);
-
-    if (rank == 0) {
-        free(global_arr);
-        global_arr = NULL;
+    if (done) {
+        /* nothing to generate or read */
+    }
+    else if (input) {
+        /* Each rank reads its own block */
+        double io_start = MPI_Wtime();
+        read_keys_all(input, local_arr, local_n, (int64_t)rank * local_n, n);
+        t_io += MPI_Wtime() - io_start;
     }
+    else {
+        /* Global array (only rank 0) */
+        int *global_arr = NULL;
+        if (rank == 0) {
+            global_arr = buf_alloc(n * sizeof(int));
 
-    MPI_Barrier(MPI_COMM_WORLD);
-    double start = MPI_Wtime();
+            phase_begin(PH_GENERATE);
+            generate_keys(global_arr, n, pattern, seed);
+            phase_end(PH_GENERATE);
+        }
 
-    /* Local sort */
-    qsort(local_arr, local_n, sizeof(int), compare_ints);
+        phase_begin(PH_SCATTER);
+        MPI_Scatter(global_arr, local_n, MPI_INT,
+                    local_arr, local_n, MPI_INT,
+                    0, MPI_COMM_WORLD);
+        phase_end(PH_SCATTER);
 
-    /* Buffers */
-    int *recv_buf = malloc(local_n * sizeof(int));
-    int *merged   = malloc(2 * local_n * sizeof(int));
+        free(global_arr);
+    }
 
-    /* Bitonic merge phases */
-    for (int k = 2; k <= size; k <<= 1) {
-        for (int j = k >> 1; j > 0; j >>= 1) {
+    /* Checksum of the input, compared with the sorted blocks */
+    key_sum in_sum = ckpt.in_sum;
+    if (!done) {
+        phase_begin(PH_VERIFY);
+        in_sum = key_sum_all(local_arr, local_n);
+        phase_end(PH_VERIFY);
+    }
+    ckpt.in_sum  = in_sum;
+    ckpt.pattern = pattern;
 
-            int partner = rank ^ j;
+    /* Pristine block, restored before every run after the first */
+    int *orig = NULL;
+    if (warmup + reps > 1) {
+        orig = malloc((size_t)local_n * sizeof(int));
+        memcpy(orig, local_arr, (size_t)local_n * sizeof(int));
+    }
 
-            MPI_Sendrecv(local_arr, local_n, MPI_INT, partner, 0,
-                         recv_buf,  local_n, MPI_INT, partner, 0,
-                         MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    double *times = (rank == 0) ? malloc((size_t)reps * sizeof(double)) : NULL;
 
-            merge_two(local_arr, local_n, recv_buf, local_n, merged);
+    for (int it = 0; it < warmup + reps; it++) {
+        if (it > 0)
+            memcpy(local_arr, orig, (size_t)local_n * sizeof(int));
+        phase_weight = (it >= warmup) ? 1.0 / reps : 0.0;
 
-            int up  = ((rank & k) == 0);
-            int low = ((rank & j) == 0);
+        MPI_Barrier(MPI_COMM_WORLD);
+        double start = MPI_Wtime();
 
-            int keep_low = (up && low) || (!up && !low);
+        bitonic_sort(local_arr, local_n, recv_buf, merged, done);
 
-            if (keep_low) {
-                for (int i = 0; i < local_n; i++)
-                    local_arr[i] = merged[i];
-            } else {
-                for (int i = 0; i < local_n; i++)
-                    local_arr[i] = merged[i + local_n];
-            }
-        }
+        /* a run lasts as long as its slowest rank */
+        double dt = MPI_Wtime() - start, max_dt;
+        MPI_Reduce(&dt, &max_dt, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        if (rank == 0 && it >= warmup)
+            times[it - warmup] = max_dt;
     }
+    phase_weight = 1.0;
+    free(orig);
 
-    double end = MPI_Wtime();
+    /* Sorted blocks to file, in rank order */
+    if (output) {
+        double io_start = MPI_Wtime();
+        write_keys_all(output, local_arr, local_n);
+        t_io += MPI_Wtime() - io_start;
+    }
 
-    /* Final gather */
-    int *final_arr = NULL;
-    if (rank == 0)
-        final_arr = malloc(n * sizeof(int));
+    double max_io = 0.0;
+    MPI_Reduce(&t_io, &max_io, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
 
-    MPI_Gather(local_arr, local_n, MPI_INT,
-               final_arr, local_n, MPI_INT,
-               0, MPI_COMM_WORLD);
+    /* Verified in place: block order plus the input checksum */
+    phase_begin(PH_VERIFY);
+    int ok = is_sorted_all(local_arr, local_n);
+    ok = key_sum_equal(in_sum, key_sum_all(local_arr, local_n)) && ok;
+    phase_end(PH_VERIFY);
 
     /* Output */
+    bench_stats st = { 0.0, 0.0, 0.0, 0.0 };
     if (rank == 0) {
 
-        double t = end - start;
-        int ok = is_sorted(final_arr, n);
+        st = bench_summary(times, reps);
 
         printf("MPI Bitonic Sort\n");
         printf("n = %" PRId64 "\n", n);
         printf("pattern = %s\n", pattern);
         printf("processes = %d\n", size);
-        printf("time = %.6f s\n", t);
-        printf("sorted = %s\n\n", ok ? "yes" : "no");
+        if (hugepages)
+            printf("pages = %s\n", page_mode());
+        print_stats(n, warmup, reps, st);
+        if (input || output)
+            printf("io time = %.6f s\n", max_io);
+    }
 
-        FILE *fp = fopen("results_mpi_bitonic.csv", "a");
-        if (fp) {
-            if (ftell(fp) == 0)
-                fprintf(fp, "n,pattern,time,sorted,processes\n");
+    char params[128] = "";
+    if (ckpt.dir)
+        ckpt_report(warmup + reps, st.median, done, params, sizeof(params));
 
-            fprintf(fp, "%" PRId64 ",%s,%.6f,%s,%d\n",
-                n, pattern, t, ok ? "yes" : "no", size);
+    if (phases)
+        phase_report(perf);
 
-            fclose(fp);
-        }
+    if (rank == 0) {
+        printf("sorted = %s\n\n", ok ? "yes" : "no");
+
+        if (hugepages)
+            snprintf(params + strlen(params), sizeof(params) - strlen(params),
+                     "%spages=huge", *params ? ";" : "");
+        write_result("mpi_bitonicsort", n, pattern, 1, size, warmup, reps, st, ok, params);
 
-        free(final_arr);
+        free(times);
     }
 
     free(local_arr);
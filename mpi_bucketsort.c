@@ -6,6 +6,12 @@
 #include <inttypes.h>
 #include <limits.h>
 #include <string.h>
+#include <math.h>
+#include <float.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <unistd.h>
 
 /* Comparator for qsort */
 static int compare_ints(const void *a, const void *b) {
@@ -21,9 +27,106 @@ static int is_sorted(const int *arr, size_t n) {
     return 1;
 }
 
-/* Safe malloc */
+/* Key checksum: order-independent, so equal before and after the sort
+   unless keys were lost, duplicated or altered. The mixed sum catches
+   changes that cancel out in sum and xor. */
+typedef struct {
+    uint64_t count, sum, xr, mix;
+} key_sum;
+
+static inline uint64_t key_mix(int key) {
+    uint64_t z = (uint64_t)(uint32_t)key + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Checksum of the keys held by all ranks (collective) */
+static key_sum key_sum_all(const int *arr, int64_t n) {
+    uint64_t part[3] = { (uint64_t)n, 0, 0 }, tot[3];
+    uint64_t xr = 0, all_xr;
+    for (int64_t i = 0; i < n; i++) {
+        part[1] += (uint64_t)(int64_t)arr[i];
+        part[2] += key_mix(arr[i]);
+        xr      ^= (uint64_t)(uint32_t)arr[i];
+    }
+    MPI_Allreduce(part, tot, 3, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(&xr, &all_xr, 1, MPI_UINT64_T, MPI_BXOR, MPI_COMM_WORLD);
+
+    key_sum ks = { tot[0], tot[1], all_xr, tot[2] };
+    return ks;
+}
+
+static int key_sum_equal(key_sum a, key_sum b) {
+    return a.count == b.count && a.sum == b.sum && a.xr == b.xr && a.mix == b.mix;
+}
+
+/* Distributed order check (collective, same answer on every rank):
+   each rank checks its slice and compares its first key with the
+   largest last key of the ranks before it (an exclusive max-scan, so
+   empty slices are skipped) */
+static int is_sorted_all(const int *arr, int64_t n) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    int ok = is_sorted(arr, (size_t)n);
+
+    int last = (n > 0) ? arr[n - 1] : INT_MIN, prev = INT_MIN;
+    MPI_Exscan(&last, &prev, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if (rank > 0 && n > 0 && prev > arr[0])
+        ok = 0;
+
+    int all_ok;
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    return all_ok;
+}
+
+/* Aligned buffers: 64-byte aligned; with --hugepages, buffers of at
+   least one huge page are 2 MB aligned and advised for transparent
+   huge pages (4 KB pages if THP is off) */
+#define HUGE_PAGE ((size_t)2 << 20)
+
+static int hugepages = 0;
+static int hugepages_denied = 0;
+
+static void *buf_alloc(size_t nbytes) {
+    int huge = hugepages && nbytes >= HUGE_PAGE;
+    size_t align = huge ? HUGE_PAGE : 64;
+    size_t len = (nbytes + align - 1) / align * align;
+    if (len == 0) len = align;
+
+    void *p = NULL;
+    if (posix_memalign(&p, align, len) != 0)
+        return NULL;
+
+    if (huge && madvise(p, len, MADV_HUGEPAGE) != 0)
+        hugepages_denied = 1;
+    return p;
+}
+
+/* One write per page, so first-touch faults stay out of timed regions */
+static void buf_prefault(void *p, size_t nbytes) {
+    volatile char *c = p;
+    for (size_t i = 0; i < nbytes; i += 4096)
+        c[i] = 0;
+}
+
+static const char *page_mode(void) {
+    if (!hugepages) return "4k";
+
+    FILE *fp = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (fp) {
+        char line[128] = "";
+        if (fgets(line, sizeof(line), fp) && strstr(line, "[never]"))
+            hugepages_denied = 1;
+        fclose(fp);
+    }
+    return hugepages_denied ? "4k (huge pages unavailable)" : "huge";
+}
+
+/* Safe allocation (aligned, see buf_alloc) */
 static void* xmalloc(size_t nbytes) {
-    void *p = malloc(nbytes);
+    void *p = buf_alloc(nbytes);
     if (!p) {
         fprintf(stderr, "malloc failed (%zu bytes)\n", nbytes);
         MPI_Abort(MPI_COMM_WORLD, 1);
@@ -46,80 +149,517 @@ static void make_quasi_sorted(int *arr, int64_t n) {
     }
 }
 
-int main(int argc, char **argv) {
-    MPI_Init(&argc, &argv);
+/* Input pattern: random, quasi or desc */
+static void generate_keys(int *arr, int64_t n, const char *pattern, unsigned int seed) {
+    srand(seed);
+    if (strcmp(pattern, "quasi") == 0) {
+        make_quasi_sorted(arr, n);
+    }
+    else if (strcmp(pattern, "desc") == 0) {
+        for (int64_t i = 0; i < n; i++)
+            arr[i] = (int)(n - 1 - i);
+    }
+    else { /* random */
+        for (int64_t i = 0; i < n; i++)
+            arr[i] = rand() % 100000;
+    }
+}
+
+/* Benchmark harness: statistics over --reps timed runs (after
+   --warmup untimed ones) and the unified results.csv row */
+#ifndef GIT_HASH
+#define GIT_HASH "unknown"
+#endif
+#ifndef BUILD_FLAGS
+#define BUILD_FLAGS "unknown"
+#endif
+
+#define RESULTS_CSV "results.csv"
+
+typedef struct {
+    double min, median, p95, stddev;
+} bench_stats;
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Summary of r timings (sorted in place); p95 is the nearest rank */
+static bench_stats bench_summary(double *t, int r) {
+    qsort(t, (size_t)r, sizeof(double), compare_doubles);
+
+    double mean = 0.0, var = 0.0;
+    for (int i = 0; i < r; i++) mean += t[i];
+    mean /= r;
+    for (int i = 0; i < r; i++) var += (t[i] - mean) * (t[i] - mean);
+
+    bench_stats s;
+    s.min    = t[0];
+    s.median = (r % 2) ? t[r / 2] : 0.5 * (t[r / 2 - 1] + t[r / 2]);
+    s.p95    = t[(int)ceil(0.95 * r) - 1];
+    s.stddev = (r > 1) ? sqrt(var / (r - 1)) : 0.0;
+    return s;
+}
+
+/* Median time plus spread and throughput on stdout */
+static void print_stats(int64_t n, int warmup, int reps, bench_stats s) {
+    double rate = (s.median > 0.0) ? (double)n / s.median : 0.0;
+
+    printf("time = %.6f s\n", s.median);
+    if (reps > 1)
+        printf("reps = %d (+%d warmup): min %.6f s, p95 %.6f s, stddev %.6f s\n",
+               reps, warmup, s.min, s.p95, s.stddev);
+    printf("rate = %.0f keys/s, %.1f MB/s\n", rate, rate * sizeof(int) / 1e6);
+}
+
+/* "model name" from /proc/cpuinfo */
+static void cpu_model(char *buf, size_t len) {
+    snprintf(buf, len, "unknown");
+
+    FILE *fp = fopen("/proc/cpuinfo", "r");
+    if (!fp) return;
+
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        char *v = strchr(line, ':');
+        if (strncmp(line, "model name", 10) == 0 && v) {
+            v += 1 + strspn(v + 1, " \t");
+            v[strcspn(v, "\n")] = '\0';
+            snprintf(buf, len, "%s", v);
+            break;
+        }
+    }
+    fclose(fp);
+}
+
+static void csv_quoted(FILE *fp, const char *s) {
+    fputc('"', fp);
+    for (; *s; s++) {
+        if (*s == '"') fputc('"', fp);
+        fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+/* One row of results.csv, the file shared by all five programs;
+   program-specific settings go to params as key=value;key=value */
+static void write_result(const char *program, int64_t n, const char *pattern,
+                         int threads, int processes, int warmup, int reps,
+                         bench_stats s, int ok, const char *params) {
+    FILE *fp = fopen(RESULTS_CSV, "a");
+    if (!fp) {
+        fprintf(stderr, "Error opening %s\n", RESULTS_CSV);
+        return;
+    }
+
+    if (ftell(fp) == 0)
+        fprintf(fp, "program,n,pattern,threads,processes,warmup,reps,"
+                    "min,median,p95,stddev,keys_per_s,bytes_per_s,sorted,"
+                    "params,git,compiler,flags,cpu\n");
+
+    double rate = (s.median > 0.0) ? (double)n / s.median : 0.0;
+    char cpu[256];
+    cpu_model(cpu, sizeof(cpu));
+
+    fprintf(fp, "%s,%" PRId64 ",%s,%d,%d,%d,%d,%.6f,%.6f,%.6f,%.6f,%.0f,%.0f,%s,",
+            program, n, pattern, threads, processes, warmup, reps,
+            s.min, s.median, s.p95, s.stddev, rate, rate * sizeof(int),
+            ok ? "yes" : "no");
+    csv_quoted(fp, params);
+    fputc(',', fp);
+    csv_quoted(fp, GIT_HASH);
+    fputc(',', fp);
+    csv_quoted(fp, __VERSION__);
+    fputc(',', fp);
+    csv_quoted(fp, BUILD_FLAGS);
+    fputc(',', fp);
+    csv_quoted(fp, cpu);
+    fputc('\n', fp);
+
+    fclose(fp);
+}
+
+/* Phase timers: named spans of a run, accumulated per rank and reported
+   on rank 0 as min/avg/max over ranks. With --perf every span also reads
+   cycles, LLC misses and branch misses (perf_event, user space only). */
+enum { PH_GENERATE, PH_SCATTER, PH_LOCAL_SORT, PH_EXCHANGE, PH_MERGE,
+       PH_GATHER, PH_CHECKPOINT, PH_VERIFY, PH_COUNT };
+
+static const char *phase_name[PH_COUNT] = {
+    "generate", "scatter", "local sort", "exchange", "merge", "gather",
+    "checkpoint", "verify"
+};
+
+#define PERF_COUNT 3
+static const char *perf_name[PERF_COUNT] = { "cycles", "llc-miss", "br-miss" };
+static int perf_fd[PERF_COUNT] = { -1, -1, -1 };
+
+static double   phase_time[PH_COUNT];
+static double   phase_t0[PH_COUNT];
+static int      phase_used[PH_COUNT];
+static uint64_t phase_ctr[PH_COUNT][PERF_COUNT];
+static uint64_t phase_c0[PH_COUNT][PERF_COUNT];
+
+/* 1/reps inside timed repetitions and 0 in warmups, so spans that repeat
+   are reported per run */
+static double phase_weight = 1.0;
+
+/* Returns how many counters could be opened (0 without PMU access) */
+static int perf_open(void) {
+    static const uint64_t config[PERF_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    int opened = 0;
+
+    for (int i = 0; i < PERF_COUNT; i++) {
+        struct perf_event_attr a;
+        memset(&a, 0, sizeof(a));
+        a.size = sizeof(a);
+        a.type = PERF_TYPE_HARDWARE;
+        a.config = config[i];
+        a.exclude_kernel = 1;
+        a.exclude_hv = 1;
+
+        perf_fd[i] = (int)syscall(__NR_perf_event_open, &a, 0, -1, -1, 0);
+        opened += (perf_fd[i] >= 0);
+    }
+    return opened;
+}
+
+static void perf_read(uint64_t *v) {
+    for (int i = 0; i < PERF_COUNT; i++)
+        if (perf_fd[i] < 0 || read(perf_fd[i], &v[i], sizeof(v[i])) != sizeof(v[i]))
+            v[i] = 0;
+}
+
+static void phase_begin(int ph) {
+    perf_read(phase_c0[ph]);
+    phase_t0[ph] = MPI_Wtime();
+}
+
+static void phase_end(int ph) {
+    double t = MPI_Wtime();
+    uint64_t c[PERF_COUNT];
+    perf_read(c);
+
+    phase_used[ph] = 1;
+    phase_time[ph] += (t - phase_t0[ph]) * phase_weight;
+    for (int i = 0; i < PERF_COUNT; i++)
+        phase_ctr[ph][i] += (uint64_t)((double)(c[i] - phase_c0[ph][i]) * phase_weight);
+}
+
+/* Collective: rank 0 prints one line per phase, with min/avg/max over
+   the ranks that entered it; counters are summed over ranks */
+static void phase_report(int perf) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    double mine[PH_COUNT], tmin[PH_COUNT], tmax[PH_COUNT], tsum[PH_COUNT];
+    int used[PH_COUNT];
+    uint64_t ctr[PH_COUNT][PERF_COUNT];
+    int have = 0, open = (perf_fd[0] >= 0) + (perf_fd[1] >= 0) + (perf_fd[2] >= 0);
+
+    for (int ph = 0; ph < PH_COUNT; ph++)
+        mine[ph] = phase_used[ph] ? phase_time[ph] : DBL_MAX;
+
+    MPI_Reduce(mine, tmin, PH_COUNT, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+    MPI_Reduce(phase_time, tmax, PH_COUNT, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(phase_time, tsum, PH_COUNT, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(phase_used, used, PH_COUNT, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(phase_ctr, ctr, PH_COUNT * PERF_COUNT, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&open, &have, 1, MPI_INT, MPI_MIN, 0, MPI_COMM_WORLD);
+
+    if (rank != 0) return;
+
+    printf("phases (s, min/avg/max over ranks):\n");
+    for (int ph = 0; ph < PH_COUNT; ph++) {
+        if (!used[ph]) continue;
+        printf("  %-10s %.6f %.6f %.6f (%d rank%s)", phase_name[ph],
+               tmin[ph], tsum[ph] / used[ph], tmax[ph],
+               used[ph], used[ph] > 1 ? "s" : "");
+        if (perf && have)
+            for (int i = 0; i < PERF_COUNT; i++)
+                if (perf_fd[i] >= 0)
+                    printf("  %s %.3e", perf_name[i], (double)ctr[ph][i]);
+        printf("\n");
+    }
+    if (perf && !have)
+        printf("  perf counters unavailable (perf_event_open failed)\n");
+}
+
+/* Command-line options (--name=value); positional args are moved first */
+static int split_args(int argc, char **argv) {
+    int k = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            char *tmp = argv[i];
+            memmove(&argv[k + 1], &argv[k], (size_t)(i - k) * sizeof(char *));
+            argv[k++] = tmp;
+        }
+    }
+    return k;
+}
+
+static const char *get_opt(int argc, char **argv, const char *name) {
+    size_t len = strlen(name);
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) continue;
+        if (strncmp(argv[i] + 2, name, len) != 0) continue;
+        if (argv[i][2 + len] == '=') return argv[i] + 3 + len;
+        if (argv[i][2 + len] == '\0') return "";
+    }
+    return NULL;
+}
+
+/* Collective read of this rank's slice [first, first + count) of a raw
+   int32 key file holding at least n keys */
+static void read_keys_all(const char *path, int *buf, int count,
+                          int64_t first, int64_t n) {
+    MPI_File fh;
+    if (MPI_File_open(MPI_COMM_WORLD, path, MPI_MODE_RDONLY,
+                      MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        fprintf(stderr, "Error opening %s\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    MPI_Offset fsize;
+    MPI_File_get_size(fh, &fsize);
+    if (fsize < (MPI_Offset)(n * (int64_t)sizeof(int))) {
+        fprintf(stderr, "Error: %s holds fewer than %" PRId64 " keys\n", path, n);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    MPI_File_read_at_all(fh, (MPI_Offset)(first * (int64_t)sizeof(int)),
+                         buf, count, MPI_INT, MPI_STATUS_IGNORE);
+    MPI_File_close(&fh);
+}
+
+/* Collective write: every rank appends its count keys at the offset
+   given by the exclusive prefix sum of the counts in rank order */
+static void write_keys_all(const char *path, const int *buf, int count) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    int64_t mine = count, first = 0;
+    MPI_Exscan(&mine, &first, 1, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) first = 0;
+
+    MPI_File fh;
+    if (MPI_File_open(MPI_COMM_WORLD, path,
+                      MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        fprintf(stderr, "Error opening %s\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    MPI_File_set_size(fh, 0);
+    MPI_File_write_at_all(fh, (MPI_Offset)(first * (int64_t)sizeof(int)),
+                          buf, count, MPI_INT, MPI_STATUS_IGNORE);
+    MPI_File_close(&fh);
+}
+
+/* Checkpoint / restart (--checkpoint=DIR, --restart). At phase
+   boundaries every rank writes the keys it holds with collective MPI-IO
+   to DIR/<program>.ckpt: a header (rank 0), the per-rank counts, then
+   the keys in rank order. Each checkpoint goes to a .tmp file that rank
+   0 renames once all ranks have synced and closed it, so the named file
+   always holds the last complete phase. --restart reads it back and the
+   sort resumes after that phase. */
+#define CKPT_MAGIC 0x54504b43u   /* "CKPT" */
+
+typedef struct {
+    uint32_t magic;
+    int32_t  procs;
+    int64_t  n;
+    int32_t  done;               /* phases completed */
+    char     pattern[20];
+    key_sum  in_sum;             /* input checksum, verified after restart */
+} ckpt_header;
+
+static struct {
+    const char *dir;             /* NULL: checkpoints off */
+    const char *program;
+    const char *pattern;
+    int64_t     n;
+    key_sum     in_sum;
+    int         fail_after;      /* --fail-after: abort after this phase */
+    int         writes;
+    int64_t     bytes;           /* this rank, all writes */
+    double      time;            /* this rank, all writes */
+} ckpt;
+
+static void ckpt_path(char *path, size_t len, const char *suffix) {
+    snprintf(path, len, "%s/%s.ckpt%s", ckpt.dir, ckpt.program, suffix);
+}
+
+/* --checkpoint=DIR, --restart and --fail-after=P (simulated failure:
+   abort once phase P of nphases is checkpointed); 0 if they are misused */
+static int ckpt_options(int argc, char **argv, const char *program, int nphases,
+                        int *restart) {
+    const char *opt;
+    ckpt.dir        = get_opt(argc, argv, "checkpoint");
+    ckpt.program    = program;
+    ckpt.fail_after = (opt = get_opt(argc, argv, "fail-after")) != NULL ? atoi(opt) : 0;
+    *restart        = (get_opt(argc, argv, "restart") != NULL);
+
+    if (ckpt.fail_after < 0 || ckpt.fail_after > nphases)
+        return 0;
+    if (ckpt.dir)
+        return *ckpt.dir != '\0';
+    return !*restart && ckpt.fail_after == 0;
+}
+
+/* Collective; no-op without --checkpoint. done counts the phases
+   completed, keys are the count keys this rank holds after them. */
+static void ckpt_save(int done, const int *keys, int count) {
+    if (!ckpt.dir)
+        return;
 
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
-    /* Args */
-    if (argc < 2) {
-        if (rank == 0)
-            fprintf(stderr,
-                    "Usage: %s <n> [pattern=random|quasi|desc] [seed]\n",
-                    argv[0]);
-        MPI_Finalize();
-        return 1;
+    phase_begin(PH_CHECKPOINT);
+    double t0 = MPI_Wtime();
+
+    int64_t mine = count, first = 0;
+    MPI_Exscan(&mine, &first, 1, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) first = 0;
+
+    char tmp[512], path[512];
+    ckpt_path(tmp, sizeof(tmp), ".tmp");
+    ckpt_path(path, sizeof(path), "");
+
+    MPI_File fh;
+    if (MPI_File_open(MPI_COMM_WORLD, tmp, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        if (rank == 0) fprintf(stderr, "Error opening %s\n", tmp);
+        MPI_Abort(MPI_COMM_WORLD, 1);
     }
+    MPI_File_set_size(fh, 0);
 
-    int64_t n = atoll(argv[1]);
-    if (n <= 0) {
-        if (rank == 0) fprintf(stderr, "n must be positive\n");
-        MPI_Finalize();
-        return 1;
+    ckpt_header h;
+    memset(&h, 0, sizeof(h));
+    h.magic  = CKPT_MAGIC;
+    h.procs  = size;
+    h.n      = ckpt.n;
+    h.done   = done;
+    h.in_sum = ckpt.in_sum;
+    snprintf(h.pattern, sizeof(h.pattern), "%s", ckpt.pattern);
+
+    MPI_Offset keys_at = (MPI_Offset)sizeof(h) + (MPI_Offset)size * sizeof(int64_t);
+    MPI_File_write_at_all(fh, 0, &h, (rank == 0) ? (int)sizeof(h) : 0, MPI_BYTE,
+                          MPI_STATUS_IGNORE);
+    MPI_File_write_at_all(fh, (MPI_Offset)sizeof(h) + (MPI_Offset)rank * sizeof(int64_t),
+                          &mine, 1, MPI_INT64_T, MPI_STATUS_IGNORE);
+    MPI_File_write_at_all(fh, keys_at + (MPI_Offset)(first * (int64_t)sizeof(int)),
+                          keys, count, MPI_INT, MPI_STATUS_IGNORE);
+    MPI_File_sync(fh);
+    MPI_File_close(&fh);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (rank == 0 && rename(tmp, path) != 0) {
+        fprintf(stderr, "Error renaming %s\n", tmp);
+        MPI_Abort(MPI_COMM_WORLD, 1);
     }
 
-    const char *pattern = (argc >= 3) ? argv[2] : "random";
+    ckpt.time  += MPI_Wtime() - t0;
+    ckpt.bytes += (int64_t)count * (int64_t)sizeof(int);
+    ckpt.writes++;
+    phase_end(PH_CHECKPOINT);
 
-    unsigned int seed = (argc >= 4)
-                        ? (unsigned int)strtoul(argv[3], NULL, 10)
-                        : (unsigned int)time(NULL);
+    if (done == ckpt.fail_after) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (rank == 0)
+            fprintf(stderr, "Simulated failure after phase %d\n", done);
+        MPI_Abort(MPI_COMM_WORLD, 2);
+    }
+}
 
-    /* Block distribution (allow uneven) */
-    int base  = (int)(n / size);
-    int extra = (int)(n % size);
-    int local_n = base + (rank < extra ? 1 : 0);
+/* Collective: loads this rank's keys from the last checkpoint into
+   *buf (grown, never shrunk, to *cap keys) and returns the phases it
+   completed, or 0 when there is no usable checkpoint for this n and
+   process count. *count, ckpt.in_sum and pattern are filled on success. */
+static int ckpt_restore(int **buf, int *cap, int *count, char *pattern, size_t plen) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
 
-    int *local = (int *)xmalloc((size_t)local_n * sizeof(int));
+    char path[512];
+    ckpt_path(path, sizeof(path), "");
 
-    int *global     = NULL;
-    int *sendcounts = NULL;
-    int *displs     = NULL;
+    MPI_File fh;
+    if (MPI_File_open(MPI_COMM_WORLD, path, MPI_MODE_RDONLY,
+                      MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        if (rank == 0) fprintf(stderr, "No checkpoint at %s, starting over\n", path);
+        return 0;
+    }
 
-    /* Rank 0 generates data with pattern */
-    if (rank == 0) {
-        global     = (int *)xmalloc((size_t)n * sizeof(int));
-        sendcounts = (int *)xmalloc(size * sizeof(int));
-        displs     = (int *)xmalloc(size * sizeof(int));
+    ckpt_header h;
+    MPI_File_read_at_all(fh, 0, &h, (int)sizeof(h), MPI_BYTE, MPI_STATUS_IGNORE);
+    if (h.magic != CKPT_MAGIC || h.procs != size || h.n != ckpt.n || h.done < 1) {
+        if (rank == 0)
+            fprintf(stderr, "Checkpoint %s is for another run (n = %" PRId64
+                    ", %d processes), starting over\n", path, h.n, h.procs);
+        MPI_File_close(&fh);
+        return 0;
+    }
 
-        int offset = 0;
-        for (int r = 0; r < size; r++) {
-            sendcounts[r] = base + (r < extra ? 1 : 0);
-            displs[r]     = offset;
-            offset       += sendcounts[r];
-        }
+    int64_t mine, first = 0;
+    MPI_File_read_at_all(fh, (MPI_Offset)sizeof(h) + (MPI_Offset)rank * sizeof(int64_t),
+                         &mine, 1, MPI_INT64_T, MPI_STATUS_IGNORE);
+    MPI_Exscan(&mine, &first, 1, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) first = 0;
 
-        srand(seed);
-        if (strcmp(pattern, "quasi") == 0) {
-            make_quasi_sorted(global, n);
-        }
-        else if (strcmp(pattern, "desc") == 0) {
-            for (int64_t i = 0; i < n; i++)
-                global[i] = (int)(n - 1 - i);
-        }
-        else { /* random */
-            for (int64_t i = 0; i < n; i++)
-                global[i] = rand() % 100000;
+    if (mine > *cap) {
+        free(*buf);
+        *buf = buf_alloc((size_t)mine * sizeof(int));
+        if (!*buf) {
+            fprintf(stderr, "rank %d: allocation failed\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, 1);
         }
+        *cap = (int)mine;
     }
 
-    /* Scatterv uneven blocks */
-    MPI_Scatterv(global, sendcounts, displs, MPI_INT,
-                 local, local_n, MPI_INT,
-                 0, MPI_COMM_WORLD);
+    MPI_Offset keys_at = (MPI_Offset)sizeof(h) + (MPI_Offset)size * sizeof(int64_t);
+    MPI_File_read_at_all(fh, keys_at + (MPI_Offset)(first * (int64_t)sizeof(int)),
+                         *buf, (int)mine, MPI_INT, MPI_STATUS_IGNORE);
+    MPI_File_close(&fh);
+
+    *count = (int)mine;
+    ckpt.in_sum = h.in_sum;
+    snprintf(pattern, plen, "%s", h.pattern);
+    return h.done;
+}
+
+/* Checkpoint cost on rank 0: writes and volume per run, slowest rank's
+   write time per run and its share of the sort time, plus the phase a
+   restart resumed after (collective) */
+static void ckpt_report(int runs, double t_sort, int done, char *params, size_t plen) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    double t_max;
+    int64_t bytes;
+    MPI_Reduce(&ckpt.time, &t_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&ckpt.bytes, &bytes, 1, MPI_INT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank != 0)
+        return;
+
+    double per_run = t_max / runs;
+    printf("checkpoint = %d writes/run, %.1f MB/run, %.6f s/run (%.1f%% of time)\n",
+           ckpt.writes / runs, (double)bytes / runs / 1e6, per_run,
+           (t_sort > 0.0) ? 100.0 * per_run / t_sort : 0.0);
+    if (done)
+        printf("restart = resumed after phase %d\n", done);
+    snprintf(params, plen, "ckpt=%d;ckpt_s=%.6f;restart=%d",
+             ckpt.writes / runs, per_run, done);
+}
 
-    /* Compute local min/max */
+/* Global [min, max] of the keys over all ranks */
+static void global_range(const int *local, int local_n, int *gmin, int *gmax) {
     int local_min = INT_MAX;
     int local_max = INT_MIN;
     for (int i = 0; i < local_n; ++i) {
@@ -127,25 +667,152 @@ int main(int argc, char **argv) {
         if (local[i] > local_max) local_max = local[i];
     }
 
-    int gmin, gmax;
-    MPI_Allreduce(&local_min, &gmin, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
-    MPI_Allreduce(&local_max, &gmax, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    MPI_Allreduce(&local_min, gmin, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    MPI_Allreduce(&local_max, gmax, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+}
 
-    int range = gmax - gmin;
-    if (range == 0) range = 1;
+/* Distributed selection: k-th smallest key (0-based) over all ranks.
+   Starts from the global [gmin, gmax] and bisects the value range,
+   one Allreduce per step, until the keys left inside it are few enough
+   to gather on rank 0, which selects among them. All ranks return v. */
+static int select_mpi(const int *local, int local_n, int64_t k,
+                      int gmin, int gmax) {
+    const int64_t gather_max = 1 << 16;
 
-    MPI_Barrier(MPI_COMM_WORLD);
-    double t0 = MPI_Wtime();
+    int64_t lo = gmin, hi = gmax;
+    int64_t below = 0;   /* global count of keys < lo */
+
+    while (lo < hi) {
+        int64_t mid = lo + (hi - lo) / 2;
+        int64_t cnt[2] = { 0, 0 }, tot[2];   /* in [lo, hi], in [lo, mid] */
+        for (int i = 0; i < local_n; i++) {
+            cnt[0] += (local[i] >= lo && local[i] <= hi);
+            cnt[1] += (local[i] >= lo && local[i] <= mid);
+        }
+        MPI_Allreduce(cnt, tot, 2, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+        if (tot[0] <= gather_max) break;
+
+        if (below + tot[1] > k) {
+            hi = mid;
+        } else {
+            below += tot[1];
+            lo = mid + 1;
+        }
+    }
+
+    int v = (int)lo;
+    if (lo < hi) {
+        int rank, size;
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+        int *cand = (int *)xmalloc((size_t)(local_n > 0 ? local_n : 1) * sizeof(int));
+        int nc = 0;
+        for (int i = 0; i < local_n; i++)
+            if (local[i] >= lo && local[i] <= hi) cand[nc++] = local[i];
+
+        int *counts = NULL, *displs = NULL, *all = NULL;
+        if (rank == 0) {
+            counts = (int *)xmalloc(size * sizeof(int));
+            displs = (int *)xmalloc(size * sizeof(int));
+        }
+        MPI_Gather(&nc, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+        int total = 0;
+        if (rank == 0) {
+            for (int r = 0; r < size; r++) {
+                displs[r] = total;
+                total += counts[r];
+            }
+            all = (int *)xmalloc((size_t)(total > 0 ? total : 1) * sizeof(int));
+        }
+        MPI_Gatherv(cand, nc, MPI_INT, all, counts, displs, MPI_INT,
+                    0, MPI_COMM_WORLD);
+
+        if (rank == 0) {
+            qsort(all, (size_t)total, sizeof(int), compare_ints);
+            v = all[k - below];
+            free(all);
+            free(counts);
+            free(displs);
+        }
+        free(cand);
+        MPI_Bcast(&v, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    }
+
+    return v;
+}
+
+/* Distributed top-k: the k smallest keys, sorted, on rank 0 (out).
+   Selects the k-th key v, gathers the keys below v, pads with v. */
+static void topk_mpi(const int *local, int local_n, int64_t k,
+                     int gmin, int gmax, int *out) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    int v = select_mpi(local, local_n, k - 1, gmin, gmax);
+
+    int *mine = (int *)xmalloc((size_t)(local_n > 0 ? local_n : 1) * sizeof(int));
+    int nm = 0;
+    for (int i = 0; i < local_n; i++)
+        if (local[i] < v) mine[nm++] = local[i];
+
+    int *counts = NULL, *displs = NULL;
+    if (rank == 0) {
+        counts = (int *)xmalloc(size * sizeof(int));
+        displs = (int *)xmalloc(size * sizeof(int));
+    }
+    MPI_Gather(&nm, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    int below = 0;
+    if (rank == 0) {
+        for (int r = 0; r < size; r++) {
+            displs[r] = below;
+            below += counts[r];
+        }
+    }
+    MPI_Gatherv(mine, nm, MPI_INT, out, counts, displs, MPI_INT,
+                0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        qsort(out, (size_t)below, sizeof(int), compare_ints);
+        for (int64_t i = below; i < k; i++)
+            out[i] = v;
+        free(counts);
+        free(displs);
+    }
+    free(mine);
+}
+
+/* Destination bucket of a key: splitters cut [gmin, gmax] evenly */
+static inline int bucket_of(int val, int gmin, int64_t range, int size) {
+    double pos = (double)((int64_t)val - gmin) / (double)range;
+    int dest = (int)(pos * size);
+    return (dest >= size) ? size - 1 : dest;
+}
+
+/* Range splitters, all-to-all exchange and a sort of the local bucket.
+   send_buf holds local_n keys; the bucket lands in *recv_buf, which is
+   grown (never shrunk) to fit. Returns the bucket size. */
+static int bucket_sort(const int *local, int local_n, int *send_buf,
+                       int **recv_buf, int *recv_cap) {
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    /* Splitters come from the global key range; int64 so that
+       full-range keys (e.g. from --input) do not overflow */
+    phase_begin(PH_EXCHANGE);
+    int gmin, gmax;
+    global_range(local, local_n, &gmin, &gmax);
+    int64_t range = (int64_t)gmax - gmin;
+    if (range == 0) range = 1;
 
     /* Count elements per bucket */
     int *send_cnt = calloc((size_t)size, sizeof(int));
-    for (int i = 0; i < local_n; i++) {
-        int val = local[i];
-        double pos = (double)(val - gmin) / (double)range;
-        int dest = (int)(pos * size);
-        if (dest >= size) dest = size - 1;
-        send_cnt[dest]++;
-    }
+    for (int i = 0; i < local_n; i++)
+        send_cnt[bucket_of(local[i], gmin, range, size)]++;
 
     /* Prefix sum -> send displacements */
     int *sdispls = (int *)xmalloc(size * sizeof(int));
@@ -153,22 +820,14 @@ int main(int argc, char **argv) {
     for (int i = 1; i < size; i++)
         sdispls[i] = sdispls[i - 1] + send_cnt[i - 1];
 
-    int total_send = sdispls[size - 1] + send_cnt[size - 1];
-
-    int *send_buf = (int *)xmalloc((size_t)total_send * sizeof(int));
     int *cursor   = (int *)calloc((size_t)size, sizeof(int));
 
     for (int i = 0; i < local_n; i++) {
-        int val = local[i];
-        double pos = (double)(val - gmin) / (double)range;
-        int dest = (int)(pos * size);
-        if (dest >= size) dest = size - 1;
-        int idx = sdispls[dest] + cursor[dest]++;
-        send_buf[idx] = val;
+        int dest = bucket_of(local[i], gmin, range, size);
+        send_buf[sdispls[dest] + cursor[dest]++] = local[i];
     }
 
     free(cursor);
-    free(local);
 
     /* Alltoall counts */
     int *recv_cnt = (int *)xmalloc(size * sizeof(int));
@@ -182,83 +841,1167 @@ int main(int argc, char **argv) {
         rdispls[i] = rdispls[i - 1] + recv_cnt[i - 1];
 
     int total_recv = rdispls[size - 1] + recv_cnt[size - 1];
-    int *recv_buf  = (int *)xmalloc((size_t)total_recv * sizeof(int));
+    if (total_recv > *recv_cap) {
+        free(*recv_buf);
+        *recv_buf = (int *)xmalloc((size_t)total_recv * sizeof(int));
+        *recv_cap = total_recv;
+    }
 
     MPI_Alltoallv(send_buf, send_cnt, sdispls, MPI_INT,
-                  recv_buf, recv_cnt, rdispls, MPI_INT,
+                  *recv_buf, recv_cnt, rdispls, MPI_INT,
                   MPI_COMM_WORLD);
 
     free(send_cnt);
     free(sdispls);
-    free(send_buf);
     free(recv_cnt);
     free(rdispls);
+    phase_end(PH_EXCHANGE);
 
-    /* Sort local bucket */
-    qsort(recv_buf, (size_t)total_recv, sizeof(int), compare_ints);
-
-    /* Gather sizes */
-    int *final_counts = NULL;
-    if (rank == 0)
-        final_counts = (int *)xmalloc(size * sizeof(int));
+    /* The exchange is the phase worth saving: a restart from here only
+       sorts its bucket */
+    ckpt_save(1, *recv_buf, total_recv);
 
-    MPI_Gather(&total_recv, 1, MPI_INT,
-               final_counts, 1, MPI_INT,
-               0, MPI_COMM_WORLD);
+    /* Sort local bucket */
+    phase_begin(PH_LOCAL_SORT);
+    qsort(*recv_buf, (size_t)total_recv, sizeof(int), compare_ints);
+    phase_end(PH_LOCAL_SORT);
 
-    int *final_displs = NULL;
-    int  final_total  = 0;
-    int *final_arr    = NULL;
+    return total_recv;
+}
 
-    if (rank == 0) {
-        final_displs = (int *)xmalloc(size * sizeof(int));
-        final_displs[0] = 0;
+/* Stable mode (--stable): records of a key and its global input
+   position, ordered by key only. The exchange is already order
+   preserving: keys are packed per destination in local order and
+   MPI_Alltoallv lays the pieces out by source rank, so a bucket holds
+   equal keys in input order as long as the local sort is stable. */
+typedef struct {
+    int key;
+    int seq;
+} rec;
 
-        for (int i = 1; i < size; i++)
-            final_displs[i] = final_displs[i - 1] + final_counts[i - 1];
+#define REC_RUN 32   /* runs sorted by insertion before the merge passes */
 
-        final_total = final_displs[size - 1] + final_counts[size - 1];
-        final_arr   = (int *)xmalloc((size_t)final_total * sizeof(int));
+/* strict > so equal keys never pass each other */
+static void rec_insertion(rec *a, int64_t lo, int64_t hi) {
+    for (int64_t i = lo + 1; i < hi; i++) {
+        rec x = a[i];
+        int64_t j = i;
+        while (j > lo && a[j - 1].key > x.key) {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = x;
     }
+}
 
-    /* Gather all buckets to rank 0 */
-    MPI_Gatherv(recv_buf, total_recv, MPI_INT,
-                final_arr, final_counts, final_displs, MPI_INT,
-                0, MPI_COMM_WORLD);
+/* Merges a[0..na) and b[0..nb) into out; ties take a, the earlier run */
+static void rec_merge(const rec *a, int64_t na, const rec *b, int64_t nb, rec *out) {
+    int64_t i = 0, j = 0, k = 0;
+    while (i < na && j < nb)
+        out[k++] = (a[i].key <= b[j].key) ? a[i++] : b[j++];
+    while (i < na) out[k++] = a[i++];
+    while (j < nb) out[k++] = b[j++];
+}
 
-    double t1 = MPI_Wtime();
+/* Bottom-up stable mergesort of a[0..n), ping-ponging with buf */
+static void rec_mergesort(rec *a, int64_t n, rec *buf) {
+    for (int64_t lo = 0; lo < n; lo += REC_RUN)
+        rec_insertion(a, lo, (lo + REC_RUN < n) ? lo + REC_RUN : n);
 
-    if (rank == 0) {
-        int ok = is_sorted(final_arr, (size_t)final_total);
-        double t = t1 - t0;
+    rec *src = a, *dst = buf;
+    for (int64_t w = REC_RUN; w < n; w *= 2) {
+        for (int64_t lo = 0; lo < n; lo += 2 * w) {
+            int64_t mid = (lo + w < n) ? lo + w : n;
+            int64_t hi  = (lo + 2 * w < n) ? lo + 2 * w : n;
+            rec_merge(src + lo, mid - lo, src + mid, hi - mid, dst + lo);
+        }
+        rec *t = src; src = dst; dst = t;
+    }
+    if (src != a)
+        memcpy(a, src, (size_t)n * sizeof(rec));
+}
 
-        printf("MPI Bucket Sort\n");
-        printf("n = %" PRId64 "\n", n);
-        printf("pattern = %s\n", pattern);
-        printf("processes = %d\n", size);
-        printf("time = %.6f s\n", t);
-        printf("sorted = %s\n\n", ok ? "yes" : "no");
+/* Checksum of the records: a key that moves without its sequence
+   number, or a lost or repeated record, changes pair or seq_sum */
+typedef struct {
+    uint64_t count, seq_sum, pair;
+} rec_sum;
 
-        FILE *fp = fopen("results_mpi_bucketsort.csv", "a");
-        if (fp) {
-            if (ftell(fp) == 0)
-                fprintf(fp, "n,pattern,time,sorted,processes\n");
+static inline uint64_t rec_pair(rec r) {
+    return key_mix(r.key) * (2 * (uint64_t)(uint32_t)r.seq + 1);
+}
 
-            fprintf(fp, "%" PRId64 ",%s,%.6f,%s,%d\n",
-                    n, pattern, t, ok ? "yes" : "no", size);
+static int rec_sum_equal(rec_sum a, rec_sum b) {
+    return a.count == b.count && a.seq_sum == b.seq_sum && a.pair == b.pair;
+}
+
+/* Record checksum over all ranks (collective) */
+static rec_sum rec_sum_all(const rec *a, int64_t n) {
+    uint64_t v[3] = { (uint64_t)n, 0, 0 }, g[3];
+    for (int64_t i = 0; i < n; i++) {
+        v[1] += (uint64_t)(uint32_t)a[i].seq;
+        v[2] += rec_pair(a[i]);
+    }
+    MPI_Allreduce(v, g, 3, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    rec_sum rs = { g[0], g[1], g[2] };
+    return rs;
+}
+
+/* (key, seq) as one int64, so lexicographic order is integer order */
+static inline int64_t rec_rank(rec r) {
+    return (int64_t)r.key * ((int64_t)1 << 32) + (uint32_t)r.seq;
+}
+
+/* Distributed stability check (collective): every bucket ordered by
+   key, then seq, and its first record after the last record of the
+   ranks before it (MPI_Exscan, as in is_sorted_all) */
+static int rec_stable_all(const rec *a, int64_t n) {
+    int ok = 1;
+    for (int64_t i = 1; i < n && ok; i++)
+        ok = rec_rank(a[i - 1]) < rec_rank(a[i]);
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    int64_t last = (n > 0) ? rec_rank(a[n - 1]) : INT64_MIN, prev = INT64_MIN;
+    MPI_Exscan(&last, &prev, 1, MPI_INT64_T, MPI_MAX, MPI_COMM_WORLD);
+    if (rank > 0 && n > 0 && prev >= rec_rank(a[0]))
+        ok = 0;
+
+    int all;
+    MPI_Allreduce(&ok, &all, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    return all;
+}
+
+/* bucket_sort on records: same splitters and exchange, then the stable
+   mergesort instead of qsort. *recv_buf and *merge_buf grow together
+   (never shrink) to *recv_cap records. Returns the bucket size. */
+static int stable_bucket_sort(const rec *local, int local_n, rec *send_buf,
+                              rec **recv_buf, rec **merge_buf, int *recv_cap,
+                              MPI_Datatype rec_type) {
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    phase_begin(PH_EXCHANGE);
+    int local_min = INT_MAX, local_max = INT_MIN;
+    for (int i = 0; i < local_n; i++) {
+        if (local[i].key < local_min) local_min = local[i].key;
+        if (local[i].key > local_max) local_max = local[i].key;
+    }
+    int gmin, gmax;
+    MPI_Allreduce(&local_min, &gmin, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    MPI_Allreduce(&local_max, &gmax, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    int64_t range = (int64_t)gmax - gmin;
+    if (range == 0) range = 1;
+
+    int *send_cnt = calloc((size_t)size, sizeof(int));
+    for (int i = 0; i < local_n; i++)
+        send_cnt[bucket_of(local[i].key, gmin, range, size)]++;
+
+    int *sdispls = (int *)xmalloc(size * sizeof(int));
+    sdispls[0] = 0;
+    for (int i = 1; i < size; i++)
+        sdispls[i] = sdispls[i - 1] + send_cnt[i - 1];
+
+    /* in local order within each destination */
+    int *cursor = (int *)calloc((size_t)size, sizeof(int));
+    for (int i = 0; i < local_n; i++) {
+        int dest = bucket_of(local[i].key, gmin, range, size);
+        send_buf[sdispls[dest] + cursor[dest]++] = local[i];
+    }
+    free(cursor);
+
+    int *recv_cnt = (int *)xmalloc(size * sizeof(int));
+    MPI_Alltoall(send_cnt, 1, MPI_INT, recv_cnt, 1, MPI_INT, MPI_COMM_WORLD);
+
+    int *rdispls = (int *)xmalloc(size * sizeof(int));
+    rdispls[0] = 0;
+    for (int i = 1; i < size; i++)
+        rdispls[i] = rdispls[i - 1] + recv_cnt[i - 1];
+
+    int total_recv = rdispls[size - 1] + recv_cnt[size - 1];
+    if (total_recv > *recv_cap) {
+        free(*recv_buf);
+        free(*merge_buf);
+        *recv_buf  = (rec *)xmalloc((size_t)total_recv * sizeof(rec));
+        *merge_buf = (rec *)xmalloc((size_t)total_recv * sizeof(rec));
+        *recv_cap  = total_recv;
+    }
+
+    MPI_Alltoallv(send_buf, send_cnt, sdispls, rec_type,
+                  *recv_buf, recv_cnt, rdispls, rec_type,
+                  MPI_COMM_WORLD);
+
+    free(send_cnt);
+    free(sdispls);
+    free(recv_cnt);
+    free(rdispls);
+    phase_end(PH_EXCHANGE);
+
+    phase_begin(PH_LOCAL_SORT);
+    rec_mergesort(*recv_buf, total_recv, *merge_buf);
+    phase_end(PH_LOCAL_SORT);
+
+    return total_recv;
+}
+
+/* Generated keys as records, sorted by stable_bucket_sort; the keys
+   alone are also sorted once by bucket_sort as the unstable reference */
+static int run_stable(int64_t n, const char *pattern, unsigned int seed,
+                      int warmup, int reps, int phases, int perf) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    MPI_Datatype rec_type;
+    MPI_Type_contiguous(2, MPI_INT, &rec_type);
+    MPI_Type_commit(&rec_type);
+
+    int base  = (int)(n / size);
+    int extra = (int)(n % size);
+    int local_n = base + (rank < extra ? 1 : 0);
+    int64_t first = (int64_t)rank * base + (rank < extra ? rank : extra);
+
+    int *keys = (int *)xmalloc((size_t)(local_n > 0 ? local_n : 1) * sizeof(int));
+    int *global = NULL, *sendcounts = NULL, *displs = NULL;
+    if (rank == 0) {
+        global     = (int *)xmalloc((size_t)n * sizeof(int));
+        sendcounts = (int *)xmalloc(size * sizeof(int));
+        displs     = (int *)xmalloc(size * sizeof(int));
+        for (int r = 0, offset = 0; r < size; r++) {
+            sendcounts[r] = base + (r < extra ? 1 : 0);
+            displs[r]     = offset;
+            offset       += sendcounts[r];
+        }
+        phase_begin(PH_GENERATE);
+        generate_keys(global, n, pattern, seed);
+        phase_end(PH_GENERATE);
+    }
+    phase_begin(PH_SCATTER);
+    MPI_Scatterv(global, sendcounts, displs, MPI_INT,
+                 keys, local_n, MPI_INT, 0, MPI_COMM_WORLD);
+    phase_end(PH_SCATTER);
+
+    rec *local    = (rec *)xmalloc((size_t)(local_n > 0 ? local_n : 1) * sizeof(rec));
+    rec *send_buf = (rec *)xmalloc((size_t)(local_n > 0 ? local_n : 1) * sizeof(rec));
+    for (int i = 0; i < local_n; i++)
+        local[i] = (rec){ keys[i], (int)(first + i) };
+    buf_prefault(send_buf, (size_t)local_n * sizeof(rec));
+
+    phase_begin(PH_VERIFY);
+    rec_sum in_sum = rec_sum_all(local, local_n);
+    phase_end(PH_VERIFY);
+
+    double *times = (rank == 0) ? malloc((size_t)reps * sizeof(double)) : NULL;
+    rec *recv_buf = NULL, *merge_buf = NULL;
+    int recv_cap = 0, total_recv = 0;
+
+    for (int it = 0; it < warmup + reps; it++) {
+        phase_weight = (it >= warmup) ? 1.0 / reps : 0.0;
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        double t0 = MPI_Wtime();
+
+        total_recv = stable_bucket_sort(local, local_n, send_buf, &recv_buf,
+                                        &merge_buf, &recv_cap, rec_type);
+
+        double dt = MPI_Wtime() - t0, max_dt;
+        MPI_Reduce(&dt, &max_dt, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        if (rank == 0 && it >= warmup)
+            times[it - warmup] = max_dt;
+    }
+
+    /* unstable reference, kept out of the phase report */
+    phase_weight = 0.0;
+    int *key_send = (int *)xmalloc((size_t)(local_n > 0 ? local_n : 1) * sizeof(int));
+    int *key_recv = NULL, key_cap = 0;
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t0 = MPI_Wtime();
+    bucket_sort(keys, local_n, key_send, &key_recv, &key_cap);
+    double dt = MPI_Wtime() - t0, t_unstable;
+    MPI_Reduce(&dt, &t_unstable, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    phase_weight = 1.0;
+
+    phase_begin(PH_VERIFY);
+    int ok = rec_stable_all(recv_buf, total_recv);
+    ok = rec_sum_equal(in_sum, rec_sum_all(recv_buf, total_recv)) && ok;
+    phase_end(PH_VERIFY);
+
+    bench_stats st = { 0.0, 0.0, 0.0, 0.0 };
+    if (rank == 0) {
+        st = bench_summary(times, reps);
+
+        printf("MPI Bucket Sort (stable)\n");
+        printf("n = %" PRId64 "\n", n);
+        printf("pattern = %s\n", pattern);
+        printf("processes = %d\n", size);
+        if (hugepages)
+            printf("pages = %s\n", page_mode());
+        print_stats(n, warmup, reps, st);
+        printf("unstable time = %.6f s (bucket sort, keys only), stable cost %.2fx\n",
+               t_unstable, (t_unstable > 0.0) ? st.median / t_unstable : 0.0);
+    }
+
+    if (phases)
+        phase_report(perf);
+
+    if (rank == 0) {
+        printf("sorted = %s\n\n", ok ? "yes" : "no");
+
+        char params[128];
+        snprintf(params, sizeof(params), "mode=stable;unstable=%.6f%s", t_unstable,
+                 hugepages ? ";pages=huge" : "");
+        write_result("mpi_bucketsort", n, pattern, 1, size, warmup, reps, st, ok, params);
+    }
+
+    free(times);
+    free(global);
+    free(sendcounts);
+    free(displs);
+    free(key_send);
+    free(key_recv);
+    free(recv_buf);
+    free(merge_buf);
+    free(send_buf);
+    free(local);
+    free(keys);
+    MPI_Type_free(&rec_type);
+    return 0;
+}
+
+/* Batched sort (--segments): n keys cut into independent segments of
+   lo..hi keys. Ranks get contiguous runs of whole segments, balanced by
+   key count, and sort them with no exchange: short segments by
+   insertion, the rest by qsort. */
+#define SEG_SHORT 16
+
+static void insertion_sort(int *arr, int64_t n) {
+    for (int64_t i = 1; i < n; i++) {
+        int x = arr[i];
+        int64_t j = i;
+        while (j > 0 && arr[j - 1] > x) {
+            arr[j] = arr[j - 1];
+            j--;
+        }
+        arr[j] = x;
+    }
+}
+
+/* Boundaries of consecutive segments covering n keys, sizes uniform in
+   [lo, hi] and the last one cut to fit; off gets nseg + 1 entries */
+static int64_t make_segments(int64_t n, int lo, int hi, unsigned int seed,
+                             int64_t *off) {
+    unsigned int r = seed ^ 0x9e3779b9u;
+    int64_t s = 0;
+
+    off[0] = 0;
+    while (off[s] < n) {
+        int64_t len = lo + ((hi > lo) ? rand_r(&r) % (hi - lo + 1) : 0);
+        off[s + 1] = (off[s] + len < n) ? off[s] + len : n;
+        s++;
+    }
+    return s;
+}
+
+/* First segment starting at or after key pos */
+static int64_t segment_at(const int64_t *off, int64_t nseg, int64_t pos) {
+    int64_t a = 0, b = nseg;
+    while (a < b) {
+        int64_t m = a + (b - a) / 2;
+        if (off[m] < pos)
+            a = m + 1;
+        else
+            b = m;
+    }
+    return a;
+}
+
+/* Segments [s0, s1), held from local[0] = key off[s0] */
+static void sort_segments(int *local, const int64_t *off, int64_t s0, int64_t s1) {
+    for (int64_t s = s0; s < s1; s++) {
+        int *seg = local + (off[s] - off[s0]);
+        int64_t len = off[s + 1] - off[s];
+        if (len <= SEG_SHORT)
+            insertion_sort(seg, len);
+        else
+            qsort(seg, (size_t)len, sizeof(int), compare_ints);
+    }
+}
+
+static int run_segments(int64_t n, const char *pattern, unsigned int seed,
+                        int lo, int hi, int warmup, int reps) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    /* Rank 0 draws the boundaries, every rank gets all of them */
+    int64_t *off = (int64_t *)xmalloc((size_t)(n / lo + 2) * sizeof(int64_t));
+    int64_t nseg = 0;
+    if (rank == 0)
+        nseg = make_segments(n, lo, hi, seed, off);
+    MPI_Bcast(&nseg, 1, MPI_INT64_T, 0, MPI_COMM_WORLD);
+    MPI_Bcast(off, (int)(nseg + 1), MPI_INT64_T, 0, MPI_COMM_WORLD);
+
+    int64_t s0 = segment_at(off, nseg, (int64_t)rank * n / size);
+    int64_t s1 = segment_at(off, nseg, (int64_t)(rank + 1) * n / size);
+    int local_n = (int)(off[s1] - off[s0]);
+
+    int *local = (int *)xmalloc((size_t)(local_n > 0 ? local_n : 1) * sizeof(int));
+    int *orig  = (int *)xmalloc((size_t)(local_n > 0 ? local_n : 1) * sizeof(int));
+
+    int *global = NULL, *sendcounts = NULL, *displs = NULL;
+    if (rank == 0) {
+        global     = (int *)xmalloc((size_t)n * sizeof(int));
+        sendcounts = (int *)xmalloc(size * sizeof(int));
+        displs     = (int *)xmalloc(size * sizeof(int));
+        for (int r = 0; r < size; r++) {
+            int64_t a = off[segment_at(off, nseg, (int64_t)r * n / size)];
+            int64_t b = off[segment_at(off, nseg, (int64_t)(r + 1) * n / size)];
+            sendcounts[r] = (int)(b - a);
+            displs[r]     = (int)a;
+        }
+        generate_keys(global, n, pattern, seed);
+    }
+    MPI_Scatterv(global, sendcounts, displs, MPI_INT,
+                 local, local_n, MPI_INT, 0, MPI_COMM_WORLD);
+
+    key_sum in_sum = key_sum_all(local, local_n);
+    memcpy(orig, local, (size_t)local_n * sizeof(int));
+
+    double *times = (rank == 0) ? malloc((size_t)reps * sizeof(double)) : NULL;
+
+    for (int it = 0; it < warmup + reps; it++) {
+        if (it > 0)
+            memcpy(local, orig, (size_t)local_n * sizeof(int));
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        double t0 = MPI_Wtime();
+
+        sort_segments(local, off, s0, s1);
+
+        double dt = MPI_Wtime() - t0, max_dt;
+        MPI_Reduce(&dt, &max_dt, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        if (rank == 0 && it >= warmup)
+            times[it - warmup] = max_dt;
+    }
+
+    /* Every segment in order, and the same keys as before */
+    int ok = 1;
+    for (int64_t s = s0; s < s1; s++)
+        ok &= is_sorted(local + (off[s] - off[s0]), (size_t)(off[s + 1] - off[s]));
+    int all_ok;
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    ok = key_sum_equal(in_sum, key_sum_all(local, local_n)) && all_ok;
+
+    if (rank == 0) {
+        bench_stats st = bench_summary(times, reps);
+        double seg_rate = (st.median > 0.0) ? (double)nseg / st.median : 0.0;
+
+        printf("MPI Bucket Sort (segments)\n");
+        printf("n = %" PRId64 "\n", n);
+        printf("pattern = %s\n", pattern);
+        printf("processes = %d\n", size);
+        printf("segments = %" PRId64 " (%d..%d keys)\n", nseg, lo, hi);
+        if (hugepages)
+            printf("pages = %s\n", page_mode());
+        print_stats(n, warmup, reps, st);
+        printf("segment rate = %.0f segments/s\n", seg_rate);
+        printf("sorted = %s\n\n", ok ? "yes" : "no");
+
+        char params[128];
+        snprintf(params, sizeof(params),
+                 "mode=segments;seg=%d:%d;count=%" PRId64 ";seg_per_s=%.0f%s",
+                 lo, hi, nseg, seg_rate, hugepages ? ";pages=huge" : "");
+        write_result("mpi_bucketsort", n, pattern, 1, size, warmup, reps, st, ok, params);
+    }
+
+    free(times);
+    free(global);
+    free(sendcounts);
+    free(displs);
+    free(orig);
+    free(local);
+    free(off);
+    return 0;
+}
+
+/* Service mode (--serve): MPI, the ranks and their buffers stay up
+   across many sorts. Rank 0 reads jobs one per line from a job file, or
+   from stdin with --serve=- (a FIFO then keeps the service up between
+   clients), and broadcasts each line:
+
+       <n> [pattern] [seed] [--input=keys.bin]
+
+   Blank lines and lines starting with # are skipped; "quit" or end of
+   input stops the service. Startup (MPI_Init, first contact between
+   every pair of ranks) is reported once; every job reports its latency,
+   from reading the line to the verified result, and the sort time
+   inside it (slowest rank for both). */
+#define JOB_LINE 512
+#define JOB_ARGS 16
+
+/* Grow-only key buffer, faulted in when it grows, so a job no larger
+   than an earlier one touches no new pages */
+typedef struct {
+    int    *p;
+    int64_t cap;
+} key_arena;
+
+static int *arena_reserve(key_arena *a, int64_t n) {
+    if (n <= a->cap)
+        return a->p;
+    free(a->p);
+    a->cap = 0;
+    if (!(a->p = buf_alloc((size_t)(n > 0 ? n : 1) * sizeof(int)))) {
+        fprintf(stderr, "arena: allocation of %" PRId64 " keys failed\n", n);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    buf_prefault(a->p, (size_t)n * sizeof(int));
+    a->cap = n;
+    return a->p;
+}
+
+/* Next job line on every rank; "quit" at end of input */
+static void read_job(FILE *jobs, char *line) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0 && !fgets(line, JOB_LINE, jobs))
+        strcpy(line, "quit");
+    MPI_Bcast(line, JOB_LINE, MPI_CHAR, 0, MPI_COMM_WORLD);
+}
+
+/* Splits a job line in place into argv form (jargv[0] is a placeholder) */
+static int job_args(char *line, char **jargv) {
+    static char name[] = "job";
+    int jc = 0;
+    jargv[jc++] = name;
+    for (char *tok = strtok(line, " \t\r\n"); tok && jc < JOB_ARGS;
+         tok = strtok(NULL, " \t\r\n"))
+        jargv[jc++] = tok;
+    return jc;
+}
+
+/* Rank 0 checks that an input file holds n keys, so a bad job is
+   skipped instead of aborting the service */
+static int input_holds(const char *path, int64_t n) {
+    int rank, ok = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0) {
+        FILE *fp = fopen(path, "rb");
+        ok = fp && fseek(fp, 0, SEEK_END) == 0 &&
+             ftell(fp) >= (long)(n * (int64_t)sizeof(int));
+        if (fp) fclose(fp);
+        if (!ok)
+            fprintf(stderr, "Error: %s missing or holds fewer than %" PRId64 " keys\n",
+                    path, n);
+    }
+    MPI_Bcast(&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return ok;
+}
+
+/* One-time startup: time since launch on the slowest rank, after an
+   all-to-all so every pair of ranks has made first contact */
+static double serve_startup(const struct timespec *t_launch) {
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    int *a = calloc((size_t)size, sizeof(int));
+    int *b = calloc((size_t)size, sizeof(int));
+    MPI_Alltoall(a, 1, MPI_INT, b, 1, MPI_INT, MPI_COMM_WORLD);
+    free(a);
+    free(b);
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    double mine = (double)(t.tv_sec - t_launch->tv_sec) +
+                  (double)(t.tv_nsec - t_launch->tv_nsec) * 1e-9, all;
+    MPI_Allreduce(&mine, &all, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    return all;
+}
+
+/* Per-job line and results.csv row (rank 0): the timing columns hold
+   the sort, params the job number, startup and latency */
+static void report_job(const char *program, int job, int64_t n,
+                       const char *pattern, int size, double startup,
+                       double latency, double t_sort, int ok) {
+    printf("job %d: n = %" PRId64 ", pattern = %s, latency = %.6f s, "
+           "sort = %.6f s, sorted = %s\n",
+           job, n, pattern, latency, t_sort, ok ? "yes" : "no");
+    fflush(stdout);
+
+    char params[128];
+    snprintf(params, sizeof(params), "mode=serve;job=%d;startup=%.6f;latency=%.6f%s",
+             job, startup, latency, hugepages ? ";pages=huge" : "");
+    write_result(program, n, pattern, 1, size, 0, 1, bench_summary(&t_sort, 1), ok, params);
+}
+
+static void serve_summary(double *lat, int done, int seen, int failed) {
+    if (done == 0)
+        return;
+    bench_stats st = bench_summary(lat, done);
+    printf("jobs = %d, failed = %d\n", seen, failed);
+    printf("latency = %.6f s median, %.6f s min, %.6f s p95\n\n",
+           st.median, st.min, st.p95);
+}
+
+static int serve_jobs(const char *path, const struct timespec *t_launch) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
 
-            fclose(fp);
+    FILE *jobs = NULL;
+    int opened = 1;
+    if (rank == 0) {
+        jobs = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+        opened = (jobs != NULL);
+        if (!opened)
+            fprintf(stderr, "Error opening %s\n", path);
+    }
+    MPI_Bcast(&opened, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (!opened)
+        return 1;
+
+    key_arena a_global = { NULL, 0 }, a_local = { NULL, 0 }, a_send = { NULL, 0 };
+    int *recv_buf = NULL, recv_cap = 0;
+    int *sendcounts = (int *)xmalloc(size * sizeof(int));
+    int *displs     = (int *)xmalloc(size * sizeof(int));
+
+    double startup = serve_startup(t_launch);
+    if (rank == 0) {
+        printf("MPI Bucket Sort (service)\n");
+        printf("processes = %d\n", size);
+        printf("startup = %.6f s\n", startup);
+        fflush(stdout);
+    }
+
+    int cap = 64, seen = 0, done = 0, failed = 0;
+    double *lat = malloc((size_t)cap * sizeof(double));
+    char line[JOB_LINE];
+
+    for (;;) {
+        read_job(jobs, line);
+        /* latency starts once the line is in, not while waiting for it */
+        double t0 = MPI_Wtime();
+
+        char *jargv[JOB_ARGS];
+        int jc = job_args(line, jargv);
+        if (jc < 2 || jargv[1][0] == '#')
+            continue;
+        if (strcmp(jargv[1], "quit") == 0)
+            break;
+        seen++;
+
+        int npos = split_args(jc, jargv);
+        int64_t n = (npos >= 2) ? atoll(jargv[1]) : 0;
+        if (n <= 0 || n > INT_MAX) {
+            if (rank == 0)
+                fprintf(stderr, "job %d: n must be in [1, %d]\n", seen, INT_MAX);
+            failed++;
+            continue;
+        }
+
+        const char *pattern = (npos >= 3) ? jargv[2] : "random";
+        unsigned int seed = (npos >= 4)
+                            ? (unsigned int)strtoul(jargv[3], NULL, 10)
+                            : (unsigned int)time(NULL);
+        const char *input = get_opt(jc, jargv, "input");
+        if (input && !input_holds(input, n)) {
+            failed++;
+            continue;
+        }
+
+        /* Block distribution (allow uneven) */
+        int base  = (int)(n / size);
+        int extra = (int)(n % size);
+        int local_n = base + (rank < extra ? 1 : 0);
+        int *local    = arena_reserve(&a_local, local_n);
+        int *send_buf = arena_reserve(&a_send, local_n);
+
+        if (input) {
+            int64_t first = (int64_t)rank * base + (rank < extra ? rank : extra);
+            read_keys_all(input, local, local_n, first, n);
+            pattern = "file";
+        }
+        else {
+            int *global = NULL;
+            if (rank == 0) {
+                global = arena_reserve(&a_global, n);
+                generate_keys(global, n, pattern, seed);
+            }
+            int offset = 0;
+            for (int r = 0; r < size; r++) {
+                sendcounts[r] = base + (r < extra ? 1 : 0);
+                displs[r]     = offset;
+                offset       += sendcounts[r];
+            }
+            MPI_Scatterv(global, sendcounts, displs, MPI_INT,
+                         local, local_n, MPI_INT,
+                         0, MPI_COMM_WORLD);
+        }
+        key_sum in_sum = key_sum_all(local, local_n);
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        double s0 = MPI_Wtime();
+        int total_recv = bucket_sort(local, local_n, send_buf, &recv_buf, &recv_cap);
+        double t_sort = MPI_Wtime() - s0;
+
+        int ok = is_sorted_all(recv_buf, total_recv);
+        ok = key_sum_equal(in_sum, key_sum_all(recv_buf, total_recv)) && ok;
+
+        double t[2] = { MPI_Wtime() - t0, t_sort }, tmax[2];
+        MPI_Reduce(t, tmax, 2, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+        done++;
+        if (!ok)
+            failed++;
+        if (done == cap)
+            lat = realloc(lat, (size_t)(cap *= 2) * sizeof(double));
+        lat[done - 1] = tmax[0];
+
+        if (rank == 0)
+            report_job("mpi_bucketsort", seen, n, pattern, size, startup,
+                       tmax[0], tmax[1], ok);
+    }
+
+    if (rank == 0) {
+        serve_summary(lat, done, seen, failed);
+        if (jobs != stdin)
+            fclose(jobs);
+    }
+
+    free(lat);
+    free(sendcounts);
+    free(displs);
+    free(recv_buf);
+    free(a_global.p);
+    free(a_local.p);
+    free(a_send.p);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct timespec t_launch;
+    clock_gettime(CLOCK_MONOTONIC, &t_launch);
+
+    MPI_Init(&argc, &argv);
+
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    /* Args */
+    int npos = split_args(argc, argv);
+
+    /* Service mode: no positional arguments, jobs come from a file */
+    const char *serve = get_opt(argc, argv, "serve");
+    if (serve) {
+        hugepages = (get_opt(argc, argv, "hugepages") != NULL);
+        int rc = serve_jobs(*serve ? serve : "-", &t_launch);
+        MPI_Finalize();
+        return rc;
+    }
+
+    if (npos < 2) {
+        if (rank == 0)
+            fprintf(stderr,
+                    "Usage: %s <n> [pattern=random|quasi|desc] [seed]"
+                    " [--input=keys.bin] [--output=sorted.bin]"
+                    " [--topk=K | --percentile=P] [--segments=LO[:HI]] [--stable]"
+                    " [--hugepages] [--warmup=W] [--reps=R] [--phases] [--perf]"
+                    " [--checkpoint=DIR [--restart] [--fail-after=1]]\n"
+                    "       %s --serve=jobs.txt|- [--hugepages]\n",
+                    argv[0], argv[0]);
+        MPI_Finalize();
+        return 1;
+    }
+
+    int64_t n = atoll(argv[1]);
+    if (n <= 0) {
+        if (rank == 0) fprintf(stderr, "n must be positive\n");
+        MPI_Finalize();
+        return 1;
+    }
+
+    const char *pattern = (npos >= 3) ? argv[2] : "random";
+
+    const char *input  = get_opt(argc, argv, "input");
+    const char *output = get_opt(argc, argv, "output");
+    if (input) pattern = "file";
+
+    hugepages = (get_opt(argc, argv, "hugepages") != NULL);
+
+    /* W untimed warmup runs, then R timed repetitions on the same input */
+    const char *opt;
+    int warmup = (opt = get_opt(argc, argv, "warmup")) != NULL ? atoi(opt) : 0;
+    int reps   = (opt = get_opt(argc, argv, "reps"))   != NULL ? atoi(opt) : 1;
+    if (warmup < 0 || reps < 1) {
+        if (rank == 0) fprintf(stderr, "--warmup must be >= 0 and --reps >= 1\n");
+        MPI_Finalize();
+        return 1;
+    }
+
+    /* Per-phase report; --perf adds hardware counters to it */
+    int perf   = (get_opt(argc, argv, "perf") != NULL);
+    int phases = perf || (get_opt(argc, argv, "phases") != NULL);
+    if (perf)
+        perf_open();
+
+    /* Top-k (k smallest, sorted) or percentile (single k-th key) */
+    const char *select_mode = NULL;
+    int64_t k = 0;
+    if ((opt = get_opt(argc, argv, "topk")) != NULL) {
+        select_mode = "topk";
+        k = atoll(opt);
+    }
+    else if ((opt = get_opt(argc, argv, "percentile")) != NULL) {
+        select_mode = "nth";
+        double p = atof(opt);
+        k = (p < 0.0 || p > 100.0) ? -1 : (int64_t)(p / 100.0 * (double)(n - 1));
+    }
+
+    if (select_mode && (k < 0 || (strcmp(select_mode, "topk") == 0 && (k < 1 || k > n)))) {
+        if (rank == 0) fprintf(stderr, "k must be in [1, n] and percentile in [0, 100]\n");
+        MPI_Finalize();
+        return 1;
+    }
+    int topk = select_mode && strcmp(select_mode, "topk") == 0;
+
+    /* selection is not split into phases */
+    if (select_mode && phases) {
+        if (rank == 0) fprintf(stderr, "--phases/--perf are not available with --topk/--percentile\n");
+        MPI_Finalize();
+        return 1;
+    }
+
+    unsigned int seed = (npos >= 4)
+                        ? (unsigned int)strtoul(argv[3], NULL, 10)
+                        : (unsigned int)time(NULL);
+
+    /* Checkpoint after the exchange; --restart resumes from it */
+    int nphases = 1;   /* the exchange */
+
+    int restart;
+    if (!ckpt_options(argc, argv, "mpi_bucketsort", nphases, &restart)) {
+        if (rank == 0)
+            fprintf(stderr, "Error: --restart and --fail-after need --checkpoint=DIR,"
+                            " and --fail-after=P needs 1 <= P <= %d\n", nphases);
+        MPI_Finalize();
+        return 1;
+    }
+    if (ckpt.dir && (select_mode || get_opt(argc, argv, "stable") != NULL
+                     || get_opt(argc, argv, "segments") != NULL)) {
+        if (rank == 0)
+            fprintf(stderr, "--checkpoint needs the plain sort "
+                            "(no --topk/--percentile, --segments or --stable)\n");
+        MPI_Finalize();
+        return 1;
+    }
+    ckpt.n = n;
+
+    /* Stable mode: records sorted by key, equal keys in input order */
+    if (get_opt(argc, argv, "stable") != NULL) {
+        int rc = 1;
+        if (input || select_mode) {
+            if (rank == 0)
+                fprintf(stderr, "--stable needs generated input and no --topk/--percentile\n");
+        }
+        else
+            rc = run_stable(n, pattern, seed, warmup, reps, phases, perf);
+        MPI_Finalize();
+        return rc;
+    }
+
+    /* Batched sort: n keys cut into independent segments of LO..HI keys */
+    if ((opt = get_opt(argc, argv, "segments")) != NULL) {
+        int lo = atoi(opt);
+        const char *colon = strchr(opt, ':');
+        int hi = colon ? atoi(colon + 1) : lo;
+        int rc = 1;
+        if (lo < 1 || hi < lo || input || select_mode) {
+            if (rank == 0)
+                fprintf(stderr, "--segments=LO[:HI] needs 1 <= LO <= HI, "
+                                "generated input and no --topk/--percentile\n");
+        }
+        else
+            rc = run_segments(n, pattern, seed, lo, hi, warmup, reps);
+        MPI_Finalize();
+        return rc;
+    }
+
+    /* Block distribution (allow uneven) */
+    int base  = (int)(n / size);
+    int extra = (int)(n % size);
+    int local_n = base + (rank < extra ? 1 : 0);
+
+    int *local = (int *)xmalloc((size_t)local_n * sizeof(int));
+
+    int *global     = NULL;
+    int *sendcounts = NULL;
+    int *displs     = NULL;
+
+    /* Restart: the rank's bucket, pattern and input checksum from the
+       checkpoint, one run */
+    int *recv_buf   = NULL;
+    int  recv_cap   = 0;
+    int  total_recv = 0;
+    int  done       = 0;
+    char ckpt_pattern[20];
+    if (restart) {
+        done = ckpt_restore(&recv_buf, &recv_cap, &total_recv,
+                            ckpt_pattern, sizeof(ckpt_pattern));
+        if (done) {
+            pattern = ckpt_pattern;
+            warmup  = 0;
+            reps    = 1;
         }
+    }
+
+    double t_io = 0.0;
+
+    if (done) {
+        /* nothing to generate or read */
+    }
+    else if (input) {
+        /* Each rank reads its own slice */
+        int64_t first = (int64_t)rank * base + (rank < extra ? rank : extra);
+
+        double io_start = MPI_Wtime();
+        read_keys_all(input, local, local_n, first, n);
+        t_io += MPI_Wtime() - io_start;
+    }
+    /* Rank 0 generates data with pattern */
+    else if (rank == 0) {
+        global     = (int *)xmalloc((size_t)n * sizeof(int));
+        sendcounts = (int *)xmalloc(size * sizeof(int));
+        displs     = (int *)xmalloc(size * sizeof(int));
+
+        int offset = 0;
+        for (int r = 0; r < size; r++) {
+            sendcounts[r] = base + (r < extra ? 1 : 0);
+            displs[r]     = offset;
+            offset       += sendcounts[r];
+        }
+
+        phase_begin(PH_GENERATE);
+        generate_keys(global, n, pattern, seed);
+        phase_end(PH_GENERATE);
+    }
+
+    /* Scatterv uneven blocks */
+    if (!input && !done) {
+        phase_begin(PH_SCATTER);
+        MPI_Scatterv(global, sendcounts, displs, MPI_INT,
+                     local, local_n, MPI_INT,
+                     0, MPI_COMM_WORLD);
+        phase_end(PH_SCATTER);
+    }
+
+    /* Checksum of the input, compared with the sorted buckets */
+    key_sum in_sum = ckpt.in_sum;
+    if (!done) {
+        phase_begin(PH_VERIFY);
+        in_sum = key_sum_all(local, local_n);
+        phase_end(PH_VERIFY);
+    }
+    ckpt.in_sum  = in_sum;
+    ckpt.pattern = pattern;
+
+    /* Top-k / percentile, timed ahead of the full sort it is compared
+       with and over the same warmup and repetitions */
+    bench_stats sel_st = { 0.0, 0.0, 0.0, 0.0 };
+    int    sel_value = 0;
+    int   *topk_out  = NULL;
+
+    if (select_mode) {
+        int gmin, gmax;
+        global_range(local, local_n, &gmin, &gmax);
+
+        if (rank == 0 && topk)
+            topk_out = (int *)xmalloc((size_t)k * sizeof(int));
+
+        double *sel_times = (rank == 0) ? malloc((size_t)reps * sizeof(double)) : NULL;
+        for (int it = 0; it < warmup + reps; it++) {
+            MPI_Barrier(MPI_COMM_WORLD);
+            double s0 = MPI_Wtime();
+
+            if (topk)
+                topk_mpi(local, local_n, k, gmin, gmax, topk_out);
+            else
+                sel_value = select_mpi(local, local_n, k, gmin, gmax);
 
-        free(final_arr);
-        free(final_counts);
-        free(final_displs);
+            double dt = MPI_Wtime() - s0, max_dt;
+            MPI_Reduce(&dt, &max_dt, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+            if (rank == 0 && it >= warmup)
+                sel_times[it - warmup] = max_dt;
+        }
+
+        if (rank == 0) {
+            sel_st = bench_summary(sel_times, reps);
+            if (topk)
+                sel_value = topk_out[k - 1];
+        }
+        free(sel_times);
+    }
+
+    /* Every local key is sent somewhere, so the send buffer is local_n
+       keys and can be faulted in before the timer; the receive size is
+       only known after the count exchange */
+    int *send_buf = (int *)xmalloc((size_t)(local_n > 0 ? local_n : 1) * sizeof(int));
+    buf_prefault(send_buf, (size_t)local_n * sizeof(int));
+
+    double *times = (rank == 0) ? malloc((size_t)reps * sizeof(double)) : NULL;
+
+    /* The input slice is only read, so repetitions need no restore; the
+       receive buffer only grows, so warmups leave it faulted in, and the
+       last run's bucket is kept for output and verification */
+    for (int it = 0; it < warmup + reps; it++) {
+        phase_weight = (it >= warmup) ? 1.0 / reps : 0.0;
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        double t0 = MPI_Wtime();
+
+        if (done) {
+            /* restarted after the exchange: only the bucket sort is left */
+            phase_begin(PH_LOCAL_SORT);
+            qsort(recv_buf, (size_t)total_recv, sizeof(int), compare_ints);
+            phase_end(PH_LOCAL_SORT);
+        }
+        else
+            total_recv = bucket_sort(local, local_n, send_buf, &recv_buf, &recv_cap);
+
+        /* a run lasts as long as its slowest rank */
+        double dt = MPI_Wtime() - t0, max_dt;
+        MPI_Reduce(&dt, &max_dt, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        if (rank == 0 && it >= warmup)
+            times[it - warmup] = max_dt;
+    }
+    phase_weight = 1.0;
+
+    free(send_buf);
+    free(local);
+
+    /* Sorted buckets to file, each rank at its global offset */
+    if (output) {
+        double io_start = MPI_Wtime();
+        write_keys_all(output, recv_buf, total_recv);
+        t_io += MPI_Wtime() - io_start;
+    }
+
+    double max_io = 0.0;
+    MPI_Reduce(&t_io, &max_io, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    /* Verified in place: bucket order plus the input checksum */
+    phase_begin(PH_VERIFY);
+    int ok = is_sorted_all(recv_buf, total_recv);
+    ok = key_sum_equal(in_sum, key_sum_all(recv_buf, total_recv)) && ok;
+    phase_end(PH_VERIFY);
+
+    if (select_mode) {
+        /* The full sort is the reference answer. Top-k: the ranks send
+           their part of the first k sorted keys to rank 0, which compares
+           them with its answer. Percentile: the rank holding position k
+           compares it with the broadcast value. */
+        int64_t off = 0, my_n = total_recv;
+        MPI_Exscan(&my_n, &off, 1, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+        if (rank == 0)
+            off = 0;
+
+        int match = 1;
+        if (topk) {
+            int mine = (int)((off >= k) ? 0 : (off + my_n <= k) ? my_n : k - off);
+
+            int *counts = NULL, *displs = NULL, *ref = NULL;
+            if (rank == 0) {
+                counts = (int *)xmalloc(size * sizeof(int));
+                displs = (int *)xmalloc(size * sizeof(int));
+                ref    = (int *)xmalloc((size_t)k * sizeof(int));
+            }
+            MPI_Gather(&mine, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+            if (rank == 0) {
+                displs[0] = 0;
+                for (int r = 1; r < size; r++)
+                    displs[r] = displs[r - 1] + counts[r - 1];
+            }
+            MPI_Gatherv(recv_buf, mine, MPI_INT, ref, counts, displs, MPI_INT,
+                        0, MPI_COMM_WORLD);
+
+            if (rank == 0) {
+                for (int64_t i = 0; i < k; i++)
+                    match &= (ref[i] == topk_out[i]);
+                free(counts);
+                free(displs);
+                free(ref);
+            }
+        }
+        else {
+            MPI_Bcast(&sel_value, 1, MPI_INT, 0, MPI_COMM_WORLD);
+            if (k >= off && k < off + my_n)
+                match = (recv_buf[k - off] == sel_value);
+        }
+
+        int all_match;
+        MPI_Allreduce(&match, &all_match, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+        ok = ok && all_match;
+    }
+
+    if (rank == 0 && select_mode) {
+        double t_full = bench_summary(times, reps).median;
+
+        printf("MPI Bucket Sort (%s)\n", select_mode);
+        printf("n = %" PRId64 "\n", n);
+        printf("pattern = %s\n", pattern);
+        printf("processes = %d\n", size);
+        printf("k = %" PRId64 "\n", k);
+        printf("value = %d\n", sel_value);
+        printf("time = %.6f s\n", sel_st.median);
+        printf("full sort time = %.6f s\n", t_full);
+        printf("sorted = %s\n\n", ok ? "yes" : "no");
+
+        char params[128];
+        snprintf(params, sizeof(params), "mode=%s;k=%" PRId64 ";value=%d;full_time=%.6f",
+                 select_mode, k, sel_value, t_full);
+        write_result("mpi_bucketsort", n, pattern, 1, size, warmup, reps, sel_st, ok, params);
+    }
+    else if (!select_mode) {
+        bench_stats st = { 0.0, 0.0, 0.0, 0.0 };
+        if (rank == 0) {
+            st = bench_summary(times, reps);
+
+            printf("MPI Bucket Sort\n");
+            printf("n = %" PRId64 "\n", n);
+            printf("pattern = %s\n", pattern);
+            printf("processes = %d\n", size);
+            if (hugepages)
+                printf("pages = %s\n", page_mode());
+            print_stats(n, warmup, reps, st);
+            if (input || output)
+                printf("io time = %.6f s\n", max_io);
+        }
+
+        char params[128] = "";
+        if (ckpt.dir)
+            ckpt_report(warmup + reps, st.median, done, params, sizeof(params));
+
+        if (phases)
+            phase_report(perf);
+
+        if (rank == 0) {
+            printf("sorted = %s\n\n", ok ? "yes" : "no");
+
+            if (hugepages)
+                snprintf(params + strlen(params), sizeof(params) - strlen(params),
+                         "%spages=huge", *params ? ";" : "");
+            write_result("mpi_bucketsort", n, pattern, 1, size, warmup, reps, st, ok, params);
+        }
+    }
+
+    if (rank == 0) {
+        free(times);
         free(global);
         free(sendcounts);
         free(displs);
     }
 
     free(recv_buf);
+    free(topk_out);
 
     MPI_Finalize();
     return 0;
@@ -1,9 +1,21 @@
+#define _GNU_SOURCE   /* getcpu */
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <stdint.h>
 #include <inttypes.h>
 #include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <sys/stat.h>
 #include <omp.h>
 
 /* ============================
@@ -33,47 +45,67 @@ static int partition(int *arr, int low, int high) {
     return i + 1;
 }
 
+/* ============================
+   Insertion sort (caso base)
+   ============================ */
+static void insertion_sort(int *arr, int low, int high) {
+    for (int i = low + 1; i <= high; i++) {
+        int x = arr[i];
+        int j = i;
+        while (j > low && arr[j - 1] > x) {
+            arr[j] = arr[j - 1];
+            j--;
+        }
+        arr[j] = x;
+    }
+}
+
 /* ============================
    QuickSort secuencial
    ============================ */
-static void quicksort_seq(int *arr, int low, int high) {
-    while (low < high) {
+/* Ranges of at most grain keys are finished by insertion sort
+   (grain = 0 partitions all the way down) */
+static void quicksort_seq(int *arr, int low, int high, int grain) {
+    while (low < high && high - low >= grain) {
         int p = partition(arr, low, high);
 
         /* tail-recursion minimization */
         if (p - low < high - p) {
-            quicksort_seq(arr, low, p - 1);
+            quicksort_seq(arr, low, p - 1, grain);
             low = p + 1;
         } else {
-            quicksort_seq(arr, p + 1, high);
+            quicksort_seq(arr, p + 1, high, grain);
             high = p - 1;
         }
     }
+
+    if (low < high)
+        insertion_sort(arr, low, high);
 }
 
 /* ============================
    QuickSort paralelo (OpenMP tasks)
    ============================ */
-static void quicksort_omp(int *arr, int low, int high, int cutoff) {
+static void quicksort_omp(int *arr, int low, int high, int cutoff, int grain) {
 
     if (high - low <= cutoff) {
         /* Subproblema pequeño -> versión secuencial */
-        quicksort_seq(arr, low, high);
+        quicksort_seq(arr, low, high, grain);
         return;
     }
 
     int p = partition(arr, low, high);
 
     /* Lado izquierdo en una tarea */
-    #pragma omp task shared(arr) firstprivate(low, p, cutoff)
+    #pragma omp task shared(arr) firstprivate(low, p, cutoff, grain)
     {
-        quicksort_omp(arr, low, p - 1, cutoff);
+        quicksort_omp(arr, low, p - 1, cutoff, grain);
     }
 
     /* Lado derecho en otra tarea */
-    #pragma omp task shared(arr) firstprivate(p, high, cutoff)
+    #pragma omp task shared(arr) firstprivate(p, high, cutoff, grain)
     {
-        quicksort_omp(arr, p + 1, high, cutoff);
+        quicksort_omp(arr, p + 1, high, cutoff, grain);
     }
 
     /* Esperar a ambas tareas antes de regresar */
@@ -81,119 +113,2664 @@ static void quicksort_omp(int *arr, int low, int high, int cutoff) {
 }
 
 /* ============================
-   Check sorted
+   Batched (segmented) sort
    ============================ */
-static int is_sorted(const int *arr, int64_t n) {
-    for (int64_t i = 1; i < n; i++)
-        if (arr[i - 1] > arr[i]) return 0;
-    return 1;
+/* Segments of at most NET_KEYS keys: padded with INT_MAX to 16 lanes and
+   run through a bitonic network held in one vector (GCC vector
+   extensions). Stage s compares every lane i with lane net_idx[s][i] and
+   keeps the min where net_keep[s][i] is set, the max elsewhere. */
+#define NET_KEYS   16
+#define NET_MIN    9      /* shorter segments: insertion sort is cheaper */
+#define NET_STAGES 10
+#define SEG_CHUNK  64     /* segments per dynamic-schedule grab */
+
+typedef int v16si __attribute__((vector_size(NET_KEYS * sizeof(int))));
+
+static const v16si net_idx[NET_STAGES] = {
+    {  1,  0,  3,  2,  5,  4,  7,  6,  9,  8, 11, 10, 13, 12, 15, 14 },
+    {  2,  3,  0,  1,  6,  7,  4,  5, 10, 11,  8,  9, 14, 15, 12, 13 },
+    {  1,  0,  3,  2,  5,  4,  7,  6,  9,  8, 11, 10, 13, 12, 15, 14 },
+    {  4,  5,  6,  7,  0,  1,  2,  3, 12, 13, 14, 15,  8,  9, 10, 11 },
+    {  2,  3,  0,  1,  6,  7,  4,  5, 10, 11,  8,  9, 14, 15, 12, 13 },
+    {  1,  0,  3,  2,  5,  4,  7,  6,  9,  8, 11, 10, 13, 12, 15, 14 },
+    {  8,  9, 10, 11, 12, 13, 14, 15,  0,  1,  2,  3,  4,  5,  6,  7 },
+    {  4,  5,  6,  7,  0,  1,  2,  3, 12, 13, 14, 15,  8,  9, 10, 11 },
+    {  2,  3,  0,  1,  6,  7,  4,  5, 10, 11,  8,  9, 14, 15, 12, 13 },
+    {  1,  0,  3,  2,  5,  4,  7,  6,  9,  8, 11, 10, 13, 12, 15, 14 },
+};
+
+static const v16si net_keep[NET_STAGES] = {
+    { -1,  0,  0, -1, -1,  0,  0, -1, -1,  0,  0, -1, -1,  0,  0, -1 },
+    { -1, -1,  0,  0,  0,  0, -1, -1, -1, -1,  0,  0,  0,  0, -1, -1 },
+    { -1,  0, -1,  0,  0, -1,  0, -1, -1,  0, -1,  0,  0, -1,  0, -1 },
+    { -1, -1, -1, -1,  0,  0,  0,  0,  0,  0,  0,  0, -1, -1, -1, -1 },
+    { -1, -1,  0,  0, -1, -1,  0,  0,  0,  0, -1, -1,  0,  0, -1, -1 },
+    { -1,  0, -1,  0, -1,  0, -1,  0,  0, -1,  0, -1,  0, -1,  0, -1 },
+    { -1, -1, -1, -1, -1, -1, -1, -1,  0,  0,  0,  0,  0,  0,  0,  0 },
+    { -1, -1, -1, -1,  0,  0,  0,  0, -1, -1, -1, -1,  0,  0,  0,  0 },
+    { -1, -1,  0,  0, -1, -1,  0,  0, -1, -1,  0,  0, -1, -1,  0,  0 },
+    { -1,  0, -1,  0, -1,  0, -1,  0, -1,  0, -1,  0, -1,  0, -1,  0 },
+};
+
+static void network_sort(int *arr, int len) {
+    union { v16si v; int k[NET_KEYS]; } pad;
+    for (int i = 0; i < NET_KEYS; i++)
+        pad.k[i] = INT_MAX;
+    memcpy(pad.k, arr, (size_t)len * sizeof(int));
+    v16si v = pad.v;
+
+    /* unrolled, every shuffle has a constant pattern */
+    #pragma GCC unroll 10
+    for (int s = 0; s < NET_STAGES; s++) {
+        v16si p  = __builtin_shuffle(v, net_idx[s]);
+        v16si lt = (v < p);
+        v16si lo = (v & lt) | (p & ~lt);
+        v16si hi = (p & lt) | (v & ~lt);
+        v = (lo & net_keep[s]) | (hi & ~net_keep[s]);
+    }
+
+    pad.v = v;
+    memcpy(arr, pad.k, (size_t)len * sizeof(int));
+}
+
+/* Sorts the nseg independent segments arr[off[s] .. off[s + 1]) in place.
+   Segments are handed out dynamically (uneven sizes balance); the
+   shortest use insertion sort, up to NET_KEYS the network, the rest
+   quicksort_seq. Segments over cutoff keys
+   would leave the team waiting on one thread, so they become task-parallel
+   quicksorts afterwards. */
+static void segmented_sort(int *arr, const int64_t *off, int64_t nseg,
+                           int cutoff, int grain) {
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(dynamic, SEG_CHUNK)
+        for (int64_t s = 0; s < nseg; s++) {
+            int64_t len = off[s + 1] - off[s];
+            if (len < NET_MIN)
+                insertion_sort(arr + off[s], 0, (int)len - 1);
+            else if (len <= NET_KEYS)
+                network_sort(arr + off[s], (int)len);
+            else if (len <= cutoff)
+                quicksort_seq(arr + off[s], 0, (int)len - 1, grain);
+        }
+
+        #pragma omp single
+        for (int64_t s = 0; s < nseg; s++) {
+            int64_t len = off[s + 1] - off[s];
+            if (len > cutoff && len > NET_KEYS) {
+                #pragma omp task firstprivate(s, len)
+                quicksort_omp(arr + off[s], 0, (int)len - 1, cutoff, grain);
+            }
+        }
+    }
 }
 
 /* ============================
-   Quasi-sorted generator
+   Aligned / huge-page buffers
    ============================ */
-void make_quasi_sorted(int *arr, int64_t n, unsigned int seed) {
-    srand(seed);
+#define HUGE_PAGE ((size_t)2 << 20)
 
-    for (int64_t i = 0; i < n; i++)
-        arr[i] = (int)i;
+static int hugepages = 0;        /* --hugepages */
+static int hugepages_denied = 0; /* madvise refused or THP disabled */
 
-    int64_t swaps = n * 0.05;
+/* 64-byte aligned buffer; with --hugepages, buffers of at least one
+   huge page are 2 MB aligned and advised for transparent huge pages
+   (they stay on 4 KB pages if THP is off) */
+static void *buf_alloc(size_t nbytes) {
+    int huge = hugepages && nbytes >= HUGE_PAGE;
+    size_t align = huge ? HUGE_PAGE : 64;
+    size_t len = (nbytes + align - 1) / align * align;
+    if (len == 0) len = align;
 
-    for (int64_t i = 0; i < swaps; i++) {
-        int a = rand() % n;
-        int b = rand() % n;
-        int temp = arr[a];
-        arr[a] = arr[b];
-        arr[b] = temp;
+    void *p = NULL;
+    if (posix_memalign(&p, align, len) != 0)
+        return NULL;
+
+    if (huge && madvise(p, len, MADV_HUGEPAGE) != 0)
+        hugepages_denied = 1;
+    return p;
+}
+
+/* Writes one byte per page so first-touch faults happen here and not
+   inside a timed region; pages go to threads in static blocks, so each
+   one lands on the node of the thread that will sort it */
+static void buf_prefault(void *p, size_t nbytes) {
+    volatile char *c = p;
+    int64_t pages = (int64_t)((nbytes + 4095) / 4096);
+
+    #pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < pages; i++)
+        c[i * 4096] = 0;
+}
+
+static const char *page_mode(void) {
+    if (!hugepages) return "4k";
+
+    FILE *fp = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (fp) {
+        char line[128] = "";
+        if (fgets(line, sizeof(line), fp) && strstr(line, "[never]"))
+            hugepages_denied = 1;
+        fclose(fp);
     }
+    return hugepages_denied ? "4k (huge pages unavailable)" : "huge";
 }
 
 /* ============================
-             MAIN
+   Adaptive front end (presortedness)
    ============================ */
-int main(int argc, char **argv) {
+#define MIN_RUN            32   /* short runs are extended to this by insertion */
+#define NEARLY_SORTED_RUN  8    /* mean run length that selects the natural merge */
 
-    if (argc < 2) {
-        fprintf(stderr,
-            "Usage: %s <n> [pattern=random|quasi|desc] [seed]\n",
-            argv[0]);
-        return EXIT_FAILURE;
+static void reverse_range(int *arr, int64_t i, int64_t j) {
+    while (i < j) {
+        int t = arr[i];
+        arr[i++] = arr[j];
+        arr[j--] = t;
     }
+}
 
-    int64_t n = atoll(argv[1]);
-    if (n <= 0) {
-        fprintf(stderr, "Error: n must be positive\n");
-        return EXIT_FAILURE;
+/* One pass over arr[lo..hi): reverses every strictly descending run in
+   place, counts the adjacent inversions of the input (*inv) and the
+   run breaks left after reversal (*breaks, so runs = breaks + 1) */
+static void presort_pass(int *arr, int64_t lo, int64_t hi,
+                         int64_t *inv, int64_t *breaks) {
+    int64_t d = 0, b = 0;
+    int last_orig = 0;
+
+    for (int64_t i = lo; i < hi; ) {
+        int first = arr[i];
+        int last;
+        int64_t j = i + 1;
+
+        if (j < hi && arr[i] > arr[j]) {
+            while (j < hi && arr[j - 1] > arr[j]) j++;
+            d += j - i - 1;
+            last = arr[j - 1];
+            reverse_range(arr, i, j - 1);
+        } else {
+            while (j < hi && arr[j - 1] <= arr[j]) j++;
+            last = arr[j - 1];
+        }
+
+        if (i > lo) {
+            d += (last_orig > first);
+            b += (arr[i - 1] > arr[i]);
+        }
+
+        last_orig = last;
+        i = j;
     }
 
-    const char *pattern = "random";
-    if (argc >= 3)
-        pattern = argv[2];
+    *inv    = d;
+    *breaks = b;
+}
 
-    unsigned int seed = (argc >= 4)
-                          ? (unsigned int)strtoul(argv[3], NULL, 10)
-                          : (unsigned int)time(NULL);
+/* Ascending run starting at lo, extended to MIN_RUN keys by insertion */
+static int64_t next_run(int *arr, int64_t lo, int64_t hi) {
+    int64_t i = lo + 1;
+    while (i < hi && arr[i - 1] <= arr[i]) i++;
 
-    srand(seed);
+    int64_t end = (hi - lo < MIN_RUN) ? hi : lo + MIN_RUN;
+    for (; i < end; i++) {
+        int x = arr[i];
+        int64_t j = i;
+        while (j > lo && arr[j - 1] > x) {
+            arr[j] = arr[j - 1];
+            j--;
+        }
+        arr[j] = x;
+    }
 
-    int *arr = malloc(n * sizeof(int));
-    if (!arr) {
-        fprintf(stderr, "Memory allocation failed\n");
-        return EXIT_FAILURE;
+    return i - lo;
+}
+
+/* Merges the adjacent sorted runs arr[lo..mid) and arr[mid..hi);
+   the left run is copied to buf[lo..mid) first */
+static void merge_runs(int *arr, int64_t lo, int64_t mid, int64_t hi, int *buf) {
+    memcpy(buf + lo, arr + lo, (size_t)(mid - lo) * sizeof(int));
+
+    int64_t i = lo, j = mid, k = lo;
+    while (i < mid && j < hi)
+        arr[k++] = (buf[i] <= arr[j]) ? buf[i++] : arr[j++];
+    while (i < mid)
+        arr[k++] = buf[i++];
+}
+
+/* Powersort node power of the boundary between runs [s1, s1+n1) and
+   [s1+n1, s1+n1+n2) in an array of n keys */
+static int node_power(int64_t s1, int64_t n1, int64_t n2, int64_t n) {
+    int64_t a = 2 * s1 + n1;
+    int64_t b = a + n1 + n2;
+    int64_t m = 2 * n;
+
+    for (int l = 1; ; l++) {
+        a <<= 1;
+        b <<= 1;
+        int abit = (a >= m), bbit = (b >= m);
+        if (abit != bbit) return l;
+        if (abit) {
+            a -= m;
+            b -= m;
+        }
     }
+}
 
-    /* Generate data */
-    if (strcmp(pattern, "quasi") == 0) {
-        make_quasi_sorted(arr, n, seed);
+/* Natural mergesort of arr[lo..hi) with the powersort merge policy */
+static void natural_mergesort(int *arr, int64_t lo, int64_t hi, int *buf) {
+    struct { int64_t start, len; int power; } stack[128];
+    int top = 0;
 
-    } else if (strcmp(pattern, "desc") == 0) {
-        for (int64_t i = 0; i < n; i++)
-            arr[i] = (int)(n - 1 - i);
+    if (hi - lo < 2) return;
 
-    } else {
-        for (int64_t i = 0; i < n; i++)
-            arr[i] = rand() % 100000;
+    int64_t s1 = lo;
+    int64_t n1 = next_run(arr, s1, hi);
+
+    while (s1 + n1 < hi) {
+        int64_t s2 = s1 + n1;
+        int64_t n2 = next_run(arr, s2, hi);
+        int p = node_power(s1 - lo, n1, n2, hi - lo);
+
+        while (top > 0 && stack[top - 1].power > p) {
+            top--;
+            merge_runs(arr, stack[top].start, s1, s1 + n1, buf);
+            n1 += stack[top].len;
+            s1  = stack[top].start;
+        }
+
+        stack[top].start = s1;
+        stack[top].len   = n1;
+        stack[top].power = p;
+        top++;
+
+        s1 = s2;
+        n1 = n2;
     }
 
-    int threads = omp_get_max_threads();
-    int cutoff  = 50000;
+    while (top > 0) {
+        top--;
+        merge_runs(arr, stack[top].start, s1, s1 + n1, buf);
+        n1 += stack[top].len;
+        s1  = stack[top].start;
+    }
+}
+
+/* ============================
+   Parallel merge (tasks)
+   ============================ */
+/* Merges sorted a[0..na) and b[0..nb) into out: the median of the
+   larger input is placed by binary search in the other and both halves
+   become tasks, down to cutoff keys */
+static void merge_omp(const int *a, int64_t na, const int *b, int64_t nb,
+                      int *out, int64_t cutoff) {
+    if (na < nb) {
+        const int *tp = a; a = b; b = tp;
+        int64_t tn = na; na = nb; nb = tn;
+    }
+
+    if (na + nb <= cutoff || na == 0) {
+        int64_t i = 0, j = 0, k = 0;
+        while (i < na && j < nb)
+            out[k++] = (a[i] <= b[j]) ? a[i++] : b[j++];
+        while (i < na) out[k++] = a[i++];
+        while (j < nb) out[k++] = b[j++];
+        return;
+    }
+
+    int64_t ma = na / 2;
+    int64_t lo = 0, hi = nb;
+    while (lo < hi) {
+        int64_t m = lo + (hi - lo) / 2;
+        if (b[m] < a[ma]) lo = m + 1;
+        else hi = m;
+    }
+    int64_t mb = lo;
+
+    out[ma + mb] = a[ma];
+
+    #pragma omp task shared(a, b, out) firstprivate(ma, mb, cutoff)
+    merge_omp(a, ma, b, mb, out, cutoff);
+
+    #pragma omp task shared(a, b, out) firstprivate(ma, mb, na, nb, cutoff)
+    merge_omp(a + ma + 1, na - ma - 1, b + mb, nb - mb, out + ma + mb + 1, cutoff);
+
+    #pragma omp taskwait
+}
+
+/* ============================
+   Adaptive sort (parallel)
+   ============================ */
+/* Every thread runs presort_pass on its static block; the inversions
+   and run breaks at block edges are added afterwards. A block edge
+   that falls inside a strictly descending run is moved forward past
+   it, so the run is reversed whole (desc is one run at any thread
+   count). Nearly sorted
+   input is natural-merged block by block and the blocks are merged
+   pairwise with merge_omp; otherwise quicksort_omp takes over. buf
+   (n keys, may be NULL) is the merge scratch. Returns the strategy
+   name. */
+static const char *adaptive_sort_omp(int *arr, int64_t n, int *buf,
+                                     int cutoff, int grain,
+                                     int64_t *inv, int64_t *runs) {
+    int T = omp_get_max_threads();
+    if (T > n) T = (int)n;
+
+    int64_t *bounds = malloc((size_t)(T + 1) * sizeof(int64_t));
+    int64_t *split  = malloc((size_t)(T + 1) * sizeof(int64_t));
+    int *edge_inv   = calloc((size_t)T, sizeof(int));
+    for (int t = 0; t <= T; t++)
+        bounds[t] = split[t] = n * t / T;
+
+    /* Presort blocks: no edge inside a descending run (blocks may end
+       up empty, and only edges before a non-empty block count) */
+    for (int t = 1; t < T; t++) {
+        int64_t s = (split[t] > split[t - 1]) ? split[t] : split[t - 1];
+        while (s < n && arr[s - 1] > arr[s]) s++;
+        split[t] = s;
+    }
+
+    int64_t d = 0, b = 0;
+
+    #pragma omp parallel num_threads(T) reduction(+:d, b)
+    {
+        int t = omp_get_thread_num();
+        int edge = t > 0 && split[t] < split[t + 1];
+        if (edge)
+            edge_inv[t] = arr[split[t] - 1] > arr[split[t]];
+
+        #pragma omp barrier
+
+        int64_t dt, bt;
+        presort_pass(arr, split[t], split[t + 1], &dt, &bt);
+        d += dt;
+        b += bt;
+
+        #pragma omp barrier
+
+        if (edge) {
+            d += edge_inv[t];
+            b += arr[split[t] - 1] > arr[split[t]];
+        }
+    }
+
+    *inv  = d;
+    *runs = b + 1;
+    free(edge_inv);
+    free(split);
 
-    double start = 0.0, end = 0.0;
+    const char *strategy = "quicksort";
+
+    if (*runs == 1) {
+        strategy = "presorted";
+    }
+    else if (buf && n / *runs >= NEARLY_SORTED_RUN) {
+        strategy = "natural";
+
+        #pragma omp parallel num_threads(T)
+        {
+            int t = omp_get_thread_num();
+            natural_mergesort(arr, bounds[t], bounds[t + 1], buf);
+        }
+
+        /* Merge neighbouring blocks, ping-ponging between arr and buf */
+        int *src = arr, *dst = buf;
+        for (int width = 1; width < T; width *= 2) {
+            #pragma omp parallel
+            {
+                #pragma omp single
+                {
+                    for (int t = 0; t < T; t += 2 * width) {
+                        int64_t lo  = bounds[t];
+                        int64_t mid = bounds[(t + width < T) ? t + width : T];
+                        int64_t hi  = bounds[(t + 2 * width < T) ? t + 2 * width : T];
+
+                        #pragma omp task firstprivate(lo, mid, hi)
+                        merge_omp(src + lo, mid - lo, src + mid, hi - mid,
+                                  dst + lo, cutoff);
+                    }
+                }
+            }
+            int *tmp = src; src = dst; dst = tmp;
+        }
+
+        if (src != arr) {
+            #pragma omp parallel for schedule(static)
+            for (int64_t i = 0; i < n; i++)
+                arr[i] = src[i];
+        }
+    }
+    else {
+        #pragma omp parallel
+        {
+            #pragma omp single
+            quicksort_omp(arr, 0, (int)n - 1, cutoff, grain);
+        }
+    }
+
+    free(bounds);
+    return strategy;
+}
+
+/* ============================
+   Multiway mergesort engine
+   ============================ */
+/* --engine=merge (MCSTL style). Thread t owns the static chunk
+   [n*t/p, n*(t+1)/p): it sorts it as blocks of MW_BLOCK keys, each
+   small enough to stay in L2 with its merge scratch, and merges the
+   blocks into one run. A multisequence selection then finds, in every
+   chunk, where output position n*t/p falls, and thread t merges its p
+   pieces with a loser tree into the same range of buf. The work is
+   O(n log n) for any input order and every thread writes exactly its
+   n/p output keys. */
+#define MW_BLOCK (64 * 1024)
+
+typedef struct {
+    const int *cur, *end;
+} mw_run;
+
+static int64_t lower_bound(const int *a, int64_t n, int64_t v) {
+    int64_t lo = 0, hi = n;
+    while (lo < hi) {
+        int64_t m = lo + (hi - lo) / 2;
+        if (a[m] < v) lo = m + 1;
+        else hi = m;
+    }
+    return lo;
+}
+
+static int64_t upper_bound(const int *a, int64_t n, int64_t v) {
+    int64_t lo = 0, hi = n;
+    while (lo < hi) {
+        int64_t m = lo + (hi - lo) / 2;
+        if (a[m] <= v) lo = m + 1;
+        else hi = m;
+    }
+    return lo;
+}
+
+/* Splits the p sorted chunks seq[j][0..len[j]) at output rank r: the
+   smallest key v with at least r keys <= v is found by bisection on
+   the key range, then the keys equal to v are taken from the lowest
+   chunks first, so ties keep chunk order. pos[j] is the split in
+   chunk j; the pos[j] sum to r. */
+static void multiseq_select(const int *const *seq, const int64_t *len, int p,
+                            int64_t r, int64_t *pos) {
+    int64_t lo = INT_MIN, hi = INT_MAX;
+    while (lo < hi) {
+        int64_t v = lo + (hi - lo) / 2, c = 0;
+        for (int j = 0; j < p; j++)
+            c += upper_bound(seq[j], len[j], v);
+        if (c >= r) hi = v;
+        else lo = v + 1;
+    }
+
+    int64_t need = r;
+    for (int j = 0; j < p; j++) {
+        pos[j] = lower_bound(seq[j], len[j], lo);
+        need  -= pos[j];
+    }
+    for (int j = 0; j < p && need > 0; j++) {
+        int64_t eq = upper_bound(seq[j], len[j], lo) - pos[j];
+        int64_t take = (eq < need) ? eq : need;
+        pos[j] += take;
+        need   -= take;
+    }
+}
+
+/* Run a comes out before run b (exhausted runs lose, ties go to the
+   lower index) */
+static inline int mw_beats(const mw_run *run, int a, int b) {
+    if (run[a].cur == run[a].end) return 0;
+    if (run[b].cur == run[b].end) return 1;
+    return *run[a].cur < *run[b].cur || (*run[a].cur == *run[b].cur && a < b);
+}
+
+/* Plays the subtree at node: losers stay in tree[], the winner is returned */
+static int mw_build(int *tree, const mw_run *run, int node, int leaves) {
+    if (node >= leaves)
+        return node - leaves;
+    int a = mw_build(tree, run, 2 * node, leaves);
+    int b = mw_build(tree, run, 2 * node + 1, leaves);
+    if (mw_beats(run, a, b)) {
+        tree[node] = b;
+        return a;
+    }
+    tree[node] = a;
+    return b;
+}
+
+/* Loser-tree merge of the runs (leaves is a power of two, unused runs
+   empty) into out[0..count); one comparison per tree level per key */
+static void loser_tree_merge(mw_run *run, int leaves, int *out, int64_t count) {
+    int tree[2 * leaves];
+    int w = mw_build(tree, run, 1, leaves);
+
+    for (int64_t i = 0; i < count; i++) {
+        out[i] = *run[w].cur++;
+        for (int node = (w + leaves) >> 1; node > 0; node >>= 1) {
+            if (mw_beats(run, tree[node], w)) {
+                int t = tree[node];
+                tree[node] = w;
+                w = t;
+            }
+        }
+    }
+}
+
+/* buf: n keys of scratch, also the merge target */
+static void mway_sort(int *arr, int64_t n, int *buf) {
+    int p = omp_get_max_threads();
+    if (p > n) p = (int)n;
+
+    int leaves = 1;
+    while (leaves < p) leaves *= 2;
+
+    const int **seq = malloc((size_t)p * sizeof(int *));
+    int64_t *len    = malloc((size_t)p * sizeof(int64_t));
+    int64_t *split  = malloc((size_t)(p + 1) * p * sizeof(int64_t));
+    for (int j = 0; j < p; j++) {
+        seq[j] = arr + n * j / p;
+        len[j] = n * (j + 1) / p - n * j / p;
+        split[(size_t)p * p + j] = len[j];
+    }
+
+    #pragma omp parallel num_threads(p)
+    {
+        int t = omp_get_thread_num();
+        int64_t lo = n * t / p, hi = n * (t + 1) / p;
+
+        /* descending stretches are reversed first, so the order of the
+           input only changes how much merging is left */
+        for (int64_t b = lo; b < hi; b += MW_BLOCK) {
+            int64_t e = (b + MW_BLOCK < hi) ? b + MW_BLOCK : hi;
+            int64_t inv, breaks;
+            presort_pass(arr, b, e, &inv, &breaks);
+            natural_mergesort(arr, b, e, buf);
+        }
+        natural_mergesort(arr, lo, hi, buf);
+
+        #pragma omp barrier
+        multiseq_select(seq, len, p, lo, split + (size_t)t * p);
+        #pragma omp barrier
+
+        mw_run run[leaves];
+        for (int j = 0; j < leaves; j++) {
+            if (j < p) {
+                run[j].cur = seq[j] + split[(size_t)t * p + j];
+                run[j].end = seq[j] + split[(size_t)(t + 1) * p + j];
+            } else {
+                run[j].cur = run[j].end = NULL;
+            }
+        }
+        loser_tree_merge(run, leaves, buf + lo, hi - lo);
+
+        #pragma omp barrier
+        memcpy(arr + lo, buf + lo, (size_t)(hi - lo) * sizeof(int));
+    }
+
+    free(split);
+    free(len);
+    free(seq);
+}
+
+/* ============================
+   Selection (Floyd-Rivest nth_element)
+   ============================ */
+/* Moves the k-th smallest element of arr[low..high] to index k, with
+   nothing greater before it and nothing smaller after it. Large ranges
+   are first narrowed around k by recursing on a sample (Floyd-Rivest);
+   if the partitions keep going badly the range is just sorted
+   (introselect-style depth budget). */
+static void select_nth(int *arr, int low, int high, int k) {
+    int budget = 8;
+    for (int len = high - low + 1; len > 1; len >>= 1)
+        budget += 2;
+
+    while (high > low) {
+        if (high - low > 600) {
+            double n  = high - low + 1;
+            double i  = k - low + 1;
+            double z  = log(n);
+            double s  = 0.5 * exp(2.0 * z / 3.0);
+            double sd = 0.5 * sqrt(z * s * (n - s) / n) * (i < n / 2 ? -1 : 1);
+            int new_low  = (int)(k - i * s / n + sd);
+            int new_high = (int)(k + (n - i) * s / n + sd);
+            select_nth(arr,
+                       new_low  > low  ? new_low  : low,
+                       new_high < high ? new_high : high, k);
+        }
+
+        if (--budget < 0) {
+            quicksort_seq(arr, low, high, 0);
+            return;
+        }
+
+        int t = arr[k];
+        int i = low, j = high;
+
+        swap(&arr[low], &arr[k]);
+        if (arr[high] > t)
+            swap(&arr[high], &arr[low]);
+
+        while (i < j) {
+            swap(&arr[i], &arr[j]);
+            i++;
+            j--;
+            while (arr[i] < t) i++;
+            while (arr[j] > t) j--;
+        }
+
+        if (arr[low] == t) {
+            swap(&arr[low], &arr[j]);
+        } else {
+            j++;
+            swap(&arr[j], &arr[high]);
+        }
+
+        if (j <= k) low  = j + 1;
+        if (k <= j) high = j - 1;
+    }
+}
+
+/* ============================
+   Parallel selection helpers
+   ============================ */
+/* One parallel pass: keys below lo and keys inside [lo, hi] */
+static void count_bracket(const int *arr, int64_t n, int lo, int hi,
+                          int64_t *less, int64_t *mid) {
+    int64_t l = 0, m = 0;
+
+    #pragma omp parallel for schedule(static) reduction(+:l, m)
+    for (int64_t i = 0; i < n; i++) {
+        l += (arr[i] < lo);
+        m += (arr[i] >= lo && arr[i] <= hi);
+    }
+
+    *less = l;
+    *mid  = m;
+}
+
+/* Copies the keys inside [lo, hi] to out (input order kept per thread);
+   every thread counts its static block, then writes at its prefix offset */
+static int64_t gather_bracket(const int *arr, int64_t n, int lo, int hi, int *out) {
+    int64_t *offs = calloc((size_t)omp_get_max_threads() + 1, sizeof(int64_t));
+    int64_t total = 0;
 
     #pragma omp parallel
     {
+        int tid = omp_get_thread_num();
+        int64_t c = 0;
+
+        #pragma omp for schedule(static)
+        for (int64_t i = 0; i < n; i++)
+            c += (arr[i] >= lo && arr[i] <= hi);
+
+        offs[tid + 1] = c;
+        #pragma omp barrier
+
         #pragma omp single
         {
-            start = omp_get_wtime();
-            quicksort_omp(arr, 0, (int)n - 1, cutoff);
-            #pragma omp taskwait
-            end = omp_get_wtime();
+            for (int t = 1; t <= omp_get_num_threads(); t++)
+                offs[t] += offs[t - 1];
+            total = offs[omp_get_num_threads()];
         }
+
+        int64_t o = offs[tid];
+
+        #pragma omp for schedule(static)
+        for (int64_t i = 0; i < n; i++)
+            if (arr[i] >= lo && arr[i] <= hi)
+                out[o++] = arr[i];
     }
 
-    double t = end - start;
-    int ok = is_sorted(arr, n);
+    free(offs);
+    return total;
+}
 
-    printf("OpenMP QuickSort\n");
-    printf("n = %" PRId64 "\n", n);
-    printf("pattern = %s\n", pattern);
-    printf("threads = %d\n", threads);
-    printf("time = %.6f s\n", t);
-    printf("sorted = %s\n\n", ok ? "yes" : "no");
+/* ============================
+   Parallel selection (sample bracketing)
+   ============================ */
+/* Returns the k-th smallest key of arr[0..n) without reordering it.
+   Two splitters taken from a sorted random sample bracket rank k; one
+   parallel pass checks the bracket, the keys inside it are gathered
+   and the answer is selected among them. The bracket is widened until
+   it holds rank k. */
+static int select_omp(const int *arr, int64_t n, int64_t k) {
+    const int s = 16384;
+    int *sample = malloc((size_t)s * sizeof(int));
+    for (int i = 0; i < s; i++)
+        sample[i] = arr[(int64_t)(((uint64_t)rand() << 16 ^ (uint64_t)rand()) % (uint64_t)n)];
+    quicksort_seq(sample, 0, s - 1, 0);
 
-    /* Save to CSV */
-    FILE *fp = fopen("results_omp_quicksort.csv", "a");
-    if (fp) {
-        if (ftell(fp) == 0)
-            fprintf(fp, "n,pattern,threads,time,sorted\n");
+    int64_t pos = k * s / n;
+    int64_t delta = 256;
+    int lo, hi;
+    int64_t less, mid;
 
-        fprintf(fp, "%" PRId64 ",%s,%d,%.6f,%s\n",
-                n, pattern, threads, t, ok ? "yes" : "no");
+    for (;;) {
+        lo = (pos - delta > 0)     ? sample[pos - delta] : INT_MIN;
+        hi = (pos + delta < s - 1) ? sample[pos + delta] : INT_MAX;
+        count_bracket(arr, n, lo, hi, &less, &mid);
+        if (less <= k && k < less + mid) break;
+        delta *= 4;
+    }
+    free(sample);
 
-        fclose(fp);
+    int *buf = malloc((size_t)mid * sizeof(int));
+    gather_bracket(arr, n, lo, hi, buf);
+    select_nth(buf, 0, (int)mid - 1, (int)(k - less));
+
+    int v = buf[k - less];
+    free(buf);
+    return v;
+}
+
+/* ============================
+   Parallel top-k
+   ============================ */
+/* Writes the k smallest keys of arr, sorted, to out (arr is untouched):
+   select the k-th key v, gather the keys below v, pad with copies of v.
+   The candidates keep the input order, so they are sorted with the
+   multiway mergesort, which fixed-pivot quicksort is not safe for */
+static void topk_omp(const int *arr, int64_t n, int64_t k, int *out) {
+    int v = select_omp(arr, n, k - 1);
+
+    int64_t c = (v == INT_MIN) ? 0 : gather_bracket(arr, n, INT_MIN, v - 1, out);
+    for (int64_t i = c; i < k; i++)
+        out[i] = v;
+
+    if (c > 1) {
+        int *buf = malloc((size_t)c * sizeof(int));
+        mway_sort(out, c, buf);
+        free(buf);
     }
+}
 
-    free(arr);
-    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+/* ============================
+   NUMA placement (--numa)
+   ============================ */
+/* Topology comes from sysfs, so no libnuma is needed; on a single-node
+   machine nothing is pinned and only the bandwidth report remains. */
+static int numa_nodes(void) {
+    char path[64];
+    int nodes = 1;
+    for (int i = 0; i < 1024; i++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", i);
+        if (access(path, F_OK) == 0) nodes = i + 1;
+    }
+    return nodes;
+}
+
+static int cpu_node(int cpu, int nodes) {
+    char path[96];
+    for (int node = 0; node < nodes; node++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%d", cpu, node);
+        if (access(path, F_OK) == 0) return node;
+    }
+    return 0;
+}
+
+/* CPU for each of nthreads threads: the allowed CPUs ordered by node
+   and spread evenly, so consecutive threads (and therefore consecutive
+   static blocks of the array) share a node */
+static void numa_thread_cpus(int *thread_cpu, int nthreads, int nodes) {
+    cpu_set_t allowed;
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    int ncpus = 0;
+    int cpus[CPU_SETSIZE];
+    for (int node = 0; node < nodes; node++)
+        for (int c = 0; c < CPU_SETSIZE; c++)
+            if (CPU_ISSET(c, &allowed) && cpu_node(c, nodes) == node)
+                cpus[ncpus++] = c;
+
+    for (int t = 0; t < nthreads; t++)
+        thread_cpu[t] = (ncpus > 0) ? cpus[(int64_t)t * ncpus / nthreads] : -1;
+}
+
+static void pin_to_cpu(int cpu) {
+    if (cpu < 0) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static volatile int64_t numa_sink;
+
+/* Streaming read of every thread's static block; prints GB/s per node */
+static void numa_bandwidth(const int *arr, int64_t n, int nodes) {
+    double *bytes = calloc((size_t)nodes, sizeof(double));
+    double *secs  = calloc((size_t)nodes, sizeof(double));
+    int *members  = calloc((size_t)nodes, sizeof(int));
+    int64_t total = 0;
+
+    #pragma omp parallel reduction(+:total)
+    {
+        int t = omp_get_thread_num(), T = omp_get_num_threads();
+        int64_t lo = n * t / T, hi = n * (t + 1) / T;
+
+        unsigned int cpu = 0, node = 0;
+        getcpu(&cpu, &node);
+        if ((int)node >= nodes) node = 0;
+
+        double t0 = omp_get_wtime();
+        int64_t sum = 0;
+        for (int64_t i = lo; i < hi; i++)
+            sum += arr[i];
+        double dt = omp_get_wtime() - t0;
+        total += sum;
+
+        #pragma omp critical
+        {
+            bytes[node] += (double)(hi - lo) * sizeof(int);
+            if (dt > secs[node]) secs[node] = dt;
+            members[node]++;
+        }
+    }
+
+    for (int node = 0; node < nodes; node++)
+        if (members[node] > 0)
+            printf("  node %d: %d threads, read %.2f GB/s\n", node, members[node],
+                   secs[node] > 0.0 ? bytes[node] / secs[node] / 1e9 : 0.0);
+
+    numa_sink = total;
+    free(bytes);
+    free(secs);
+    free(members);
+}
+
+/* ============================
+   Work-stealing engine (Chase-Lev deques, pthreads)
+   ============================ */
+/* Alternative to OpenMP tasks. Every worker owns a Chase-Lev deque of
+   ranges: it partitions, pushes the larger side and keeps the smaller,
+   and thieves take the oldest (largest) range from the other end. There
+   are no joins: each finished range and each pivot subtract their keys
+   from a shared counter, and the workers stop when it reaches zero.
+   Idle workers look for victims on their own NUMA node first. */
+#define WS_DEQUE_CAP (1 << 16)
+
+typedef struct {
+    _Atomic int64_t  top;
+    char             pad_top[56];
+    _Atomic int64_t  bottom;
+    char             pad_bottom[56];
+    _Atomic uint64_t buf[WS_DEQUE_CAP];   /* (low << 32) | high */
+} ws_deque;
+
+typedef struct {
+    int     id;
+    int     node;
+    int64_t tasks;
+    int64_t steals;
+    int64_t attempts;
+    double  idle;
+} ws_stats;
+
+typedef struct {
+    int            *arr;
+    int             nworkers;
+    int             cutoff;
+    int             grain;
+    ws_deque       *deques;
+    ws_stats       *stats;
+    const int      *pin;         /* CPU per worker, or NULL */
+    pthread_barrier_t start;
+    _Atomic int64_t remaining;   /* keys not yet in their final place */
+} ws_pool;
+
+#define WS_EMPTY UINT64_MAX
+#define WS_ABORT (UINT64_MAX - 1)
+
+static inline uint64_t ws_pack(int low, int high) {
+    return ((uint64_t)(uint32_t)low << 32) | (uint32_t)high;
+}
+
+/* Owner: returns 0 when full (the caller then runs the range itself) */
+static int ws_push(ws_deque *q, uint64_t v) {
+    int64_t b = atomic_load_explicit(&q->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit(&q->top, memory_order_acquire);
+    if (b - t >= WS_DEQUE_CAP) return 0;
+
+    atomic_store_explicit(&q->buf[b & (WS_DEQUE_CAP - 1)], v, memory_order_relaxed);
+    atomic_store_explicit(&q->bottom, b + 1, memory_order_release);
+    return 1;
+}
+
+/* Owner: newest range */
+static uint64_t ws_take(ws_deque *q) {
+    int64_t b = atomic_load_explicit(&q->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&q->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = atomic_load_explicit(&q->top, memory_order_relaxed);
+
+    if (t > b) {
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+        return WS_EMPTY;
+    }
+
+    uint64_t v = atomic_load_explicit(&q->buf[b & (WS_DEQUE_CAP - 1)], memory_order_relaxed);
+    if (t == b) {
+        if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1,
+                memory_order_seq_cst, memory_order_relaxed))
+            v = WS_EMPTY;
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+    }
+    return v;
+}
+
+/* Thief: oldest range */
+static uint64_t ws_steal(ws_deque *q) {
+    int64_t t = atomic_load_explicit(&q->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&q->bottom, memory_order_acquire);
+
+    if (t >= b) return WS_EMPTY;
+
+    uint64_t v = atomic_load_explicit(&q->buf[t & (WS_DEQUE_CAP - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1,
+            memory_order_seq_cst, memory_order_relaxed))
+        return WS_ABORT;
+    return v;
+}
+
+static double ws_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void ws_run_range(ws_pool *pool, ws_deque *own, int low, int high) {
+    while (high - low > pool->cutoff) {
+        int p = partition(pool->arr, low, high);
+        atomic_fetch_sub_explicit(&pool->remaining, 1, memory_order_relaxed);
+
+        /* larger side goes to the deque, the smaller one is kept */
+        if (p - low > high - p) {
+            if (!ws_push(own, ws_pack(low, p - 1)))
+                ws_run_range(pool, own, low, p - 1);
+            low = p + 1;
+        } else {
+            if (!ws_push(own, ws_pack(p + 1, high)))
+                ws_run_range(pool, own, p + 1, high);
+            high = p - 1;
+        }
+    }
+
+    if (low <= high) {
+        quicksort_seq(pool->arr, low, high, pool->grain);
+        atomic_fetch_sub_explicit(&pool->remaining, high - low + 1, memory_order_relaxed);
+    }
+}
+
+typedef struct {
+    ws_pool *pool;
+    int      id;
+} ws_arg;
+
+static void *ws_worker(void *p) {
+    ws_arg *a = p;
+    ws_pool *pool = a->pool;
+    ws_stats *st = &pool->stats[a->id];
+    ws_deque *own = &pool->deques[a->id];
+
+    if (pool->pin)
+        pin_to_cpu(pool->pin[a->id]);
+
+    unsigned int cpu = 0, node = 0;
+    getcpu(&cpu, &node);
+    st->node = (int)node;
+    uint64_t rng = 0x9E3779B97F4A7C15ull * (uint64_t)(a->id + 1);
+
+    /* all nodes are known once every worker has read its own */
+    pthread_barrier_wait(&pool->start);
+
+    double idle_since = -1.0;
+    int misses = 0;
+
+    while (atomic_load_explicit(&pool->remaining, memory_order_relaxed) > 0) {
+        uint64_t v = ws_take(own);
+
+        if (v == WS_EMPTY && pool->nworkers > 1) {
+            rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+            int victim = (int)(rng % (uint64_t)pool->nworkers);
+
+            /* first rounds: same-node victims only */
+            if (misses < 2 * pool->nworkers && pool->stats[victim].node != st->node)
+                victim = a->id;
+
+            if (victim != a->id) {
+                st->attempts++;
+                v = ws_steal(&pool->deques[victim]);
+                if (v != WS_EMPTY && v != WS_ABORT) st->steals++;
+            }
+        }
+
+        if (v == WS_EMPTY || v == WS_ABORT) {
+            if (idle_since < 0.0) idle_since = ws_now();
+            if (++misses % 64 == 0) sched_yield();
+            continue;
+        }
+
+        if (idle_since >= 0.0) {
+            st->idle += ws_now() - idle_since;
+            idle_since = -1.0;
+        }
+        misses = 0;
+
+        st->tasks++;
+        ws_run_range(pool, own, (int)(v >> 32), (int)(uint32_t)v);
+    }
+
+    if (idle_since >= 0.0)
+        st->idle += ws_now() - idle_since;
+    return NULL;
+}
+
+/* Sorts arr[0..n) with nworkers threads; per-worker stats in stats */
+static void quicksort_ws(int *arr, int64_t n, int nworkers, int cutoff, int grain,
+                         const int *pin, ws_stats *stats) {
+    ws_pool pool;
+    pool.arr = arr;
+    pool.nworkers = nworkers;
+    pool.cutoff = cutoff;
+    pool.grain = grain;
+    pool.pin = pin;
+    pool.stats = stats;
+    pool.deques = malloc((size_t)nworkers * sizeof(ws_deque));
+    pthread_barrier_init(&pool.start, NULL, (unsigned)nworkers);
+    atomic_init(&pool.remaining, n);
+
+    for (int i = 0; i < nworkers; i++) {
+        atomic_init(&pool.deques[i].top, 0);
+        atomic_init(&pool.deques[i].bottom, 0);
+        stats[i] = (ws_stats){ i, 0, 0, 0, 0, 0.0 };
+    }
+
+    ws_push(&pool.deques[0], ws_pack(0, (int)n - 1));
+
+    ws_arg *args = malloc((size_t)nworkers * sizeof(ws_arg));
+    pthread_t *tids = malloc((size_t)nworkers * sizeof(pthread_t));
+
+    for (int i = 1; i < nworkers; i++) {
+        args[i] = (ws_arg){ &pool, i };
+        pthread_create(&tids[i], NULL, ws_worker, &args[i]);
+    }
+    args[0] = (ws_arg){ &pool, 0 };
+    ws_worker(&args[0]);
+
+    for (int i = 1; i < nworkers; i++)
+        pthread_join(tids[i], NULL);
+
+    pthread_barrier_destroy(&pool.start);
+    free(tids);
+    free(args);
+    free(pool.deques);
+}
+
+/* ============================
+   Check sorted (parallel)
+   ============================ */
+static int is_sorted(const int *arr, int64_t n) {
+    int ok = 1;
+    #pragma omp parallel for schedule(static) reduction(&:ok)
+    for (int64_t i = 1; i < n; i++)
+        ok &= (arr[i - 1] <= arr[i]);
+    return ok;
+}
+
+/* ============================
+   Key checksum (permutation check)
+   ============================ */
+/* Multiset fingerprint: count, sum, xor, a splitmix-mixed sum and the
+   product of (R - key) mod 2^61 - 1, i.e. the polynomial prod(R - x)
+   evaluated at a fixed point. None of them depends on the order, so
+   they match before and after the sort unless keys were lost,
+   duplicated or altered; two different multisets agree on the product
+   with probability at most n / 2^61. */
+typedef struct {
+    uint64_t count, sum, xr, mix, poly;
+} key_sum;
+
+#define KEY_SUM_BLOCK 4096
+#define POLY_P ((UINT64_C(1) << 61) - 1)
+#define POLY_R UINT64_C(0x1d8e4e27c47d124f)   /* < POLY_P, > any key */
+
+static inline uint64_t key_mix(int key) {
+    uint64_t z = (uint64_t)(uint32_t)key + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t mulmod61(uint64_t a, uint64_t b) {
+    unsigned __int128 z = (unsigned __int128)a * b;
+    uint64_t s = ((uint64_t)z & POLY_P) + (uint64_t)(z >> 61);
+    return (s >= POLY_P) ? s - POLY_P : s;
+}
+
+/* Product over one block with four independent chains, so the
+   multiplies overlap instead of waiting on each other */
+static uint64_t poly_block(const int *arr, int64_t n) {
+    uint64_t p0 = 1, p1 = 1, p2 = 1, p3 = 1;
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        p0 = mulmod61(p0, POLY_R - (uint32_t)arr[i]);
+        p1 = mulmod61(p1, POLY_R - (uint32_t)arr[i + 1]);
+        p2 = mulmod61(p2, POLY_R - (uint32_t)arr[i + 2]);
+        p3 = mulmod61(p3, POLY_R - (uint32_t)arr[i + 3]);
+    }
+    for (; i < n; i++)
+        p0 = mulmod61(p0, POLY_R - (uint32_t)arr[i]);
+    return mulmod61(mulmod61(p0, p1), mulmod61(p2, p3));
+}
+
+#pragma omp declare reduction(mulmod61 : uint64_t : omp_out = mulmod61(omp_out, omp_in)) \
+    initializer(omp_priv = 1)
+
+/* Blocks are split among threads; within a block the sum/xor/mix pass
+   is vectorized and the product re-reads the keys from L1 */
+static key_sum key_sum_of(const int *arr, int64_t n) {
+    uint64_t sum = 0, xr = 0, mix = 0, poly = 1;
+    #pragma omp parallel for schedule(static) \
+        reduction(+:sum, mix) reduction(^:xr) reduction(mulmod61:poly)
+    for (int64_t b = 0; b < n; b += KEY_SUM_BLOCK) {
+        int64_t e = (b + KEY_SUM_BLOCK < n) ? b + KEY_SUM_BLOCK : n;
+        #pragma omp simd reduction(+:sum, mix) reduction(^:xr)
+        for (int64_t i = b; i < e; i++) {
+            sum += (uint64_t)(int64_t)arr[i];
+            xr  ^= (uint64_t)(uint32_t)arr[i];
+            mix += key_mix(arr[i]);
+        }
+        poly = mulmod61(poly, poly_block(arr + b, e - b));
+    }
+    key_sum ks = { (uint64_t)n, sum, xr, mix, poly };
+    return ks;
+}
+
+static int key_sum_equal(key_sum a, key_sum b) {
+    return a.count == b.count && a.sum == b.sum && a.xr == b.xr &&
+           a.mix == b.mix && a.poly == b.poly;
+}
+
+/* ============================
+   Quasi-sorted generator
+   ============================ */
+void make_quasi_sorted(int *arr, int64_t n, unsigned int seed) {
+    srand(seed);
+
+    for (int64_t i = 0; i < n; i++)
+        arr[i] = (int)i;
+
+    int64_t swaps = n * 0.05;
+
+    for (int64_t i = 0; i < swaps; i++) {
+        int a = rand() % n;
+        int b = rand() % n;
+        int temp = arr[a];
+        arr[a] = arr[b];
+        arr[b] = temp;
+    }
+}
+
+/* ============================
+   Stable sort (--stable)
+   ============================ */
+/* Records of a key and its input position. Only keys are compared; the
+   sequence number is the payload that shows whether equal keys kept
+   their input order. */
+typedef struct {
+    int key;
+    int seq;
+} rec;
+
+#define REC_RUN 32   /* runs sorted by insertion before the merge passes */
+
+/* strict > so equal keys never pass each other */
+static void rec_insertion(rec *a, int64_t lo, int64_t hi) {
+    for (int64_t i = lo + 1; i < hi; i++) {
+        rec x = a[i];
+        int64_t j = i;
+        while (j > lo && a[j - 1].key > x.key) {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = x;
+    }
+}
+
+/* Merges a[0..na) and b[0..nb) into out; ties take a, the earlier run */
+static void rec_merge(const rec *a, int64_t na, const rec *b, int64_t nb, rec *out) {
+    int64_t i = 0, j = 0, k = 0;
+    while (i < na && j < nb)
+        out[k++] = (a[i].key <= b[j].key) ? a[i++] : b[j++];
+    while (i < na) out[k++] = a[i++];
+    while (j < nb) out[k++] = b[j++];
+}
+
+/* Bottom-up stable mergesort of a[0..n), ping-ponging with buf */
+static void rec_mergesort(rec *a, int64_t n, rec *buf) {
+    for (int64_t lo = 0; lo < n; lo += REC_RUN)
+        rec_insertion(a, lo, (lo + REC_RUN < n) ? lo + REC_RUN : n);
+
+    rec *src = a, *dst = buf;
+    for (int64_t w = REC_RUN; w < n; w *= 2) {
+        for (int64_t lo = 0; lo < n; lo += 2 * w) {
+            int64_t mid = (lo + w < n) ? lo + w : n;
+            int64_t hi  = (lo + 2 * w < n) ? lo + 2 * w : n;
+            rec_merge(src + lo, mid - lo, src + mid, hi - mid, dst + lo);
+        }
+        rec *t = src; src = dst; dst = t;
+    }
+    if (src != a)
+        memcpy(a, src, (size_t)n * sizeof(rec));
+}
+
+/* Checksum of the records: a key that moves without its sequence
+   number, or a lost or repeated record, changes pair or seq_sum */
+typedef struct {
+    uint64_t count, seq_sum, pair;
+} rec_sum;
+
+static inline uint64_t rec_pair(rec r) {
+    return key_mix(r.key) * (2 * (uint64_t)(uint32_t)r.seq + 1);
+}
+
+static int rec_sum_equal(rec_sum a, rec_sum b) {
+    return a.count == b.count && a.seq_sum == b.seq_sum && a.pair == b.pair;
+}
+
+static rec_sum rec_sum_of(const rec *a, int64_t n) {
+    uint64_t seq_sum = 0, pair = 0;
+    #pragma omp parallel for schedule(static) reduction(+:seq_sum, pair)
+    for (int64_t i = 0; i < n; i++) {
+        seq_sum += (uint64_t)(uint32_t)a[i].seq;
+        pair    += rec_pair(a[i]);
+    }
+    rec_sum rs = { (uint64_t)n, seq_sum, pair };
+    return rs;
+}
+
+/* Sorted by key and, among equal keys, by sequence number */
+static int rec_stable(const rec *a, int64_t n) {
+    int ok = 1;
+    #pragma omp parallel for schedule(static) reduction(&:ok)
+    for (int64_t i = 1; i < n; i++)
+        ok &= (a[i - 1].key < a[i].key ||
+               (a[i - 1].key == a[i].key && a[i - 1].seq < a[i].seq));
+    return ok;
+}
+
+#define REC_MERGE_CUTOFF 8192
+
+/* Stable counterpart of merge_omp: the inputs are never swapped, and
+   the split keeps every tie on the a side (b is cut at a lower bound
+   when a is halved, a at an upper bound when b is) */
+static void rec_merge_omp(const rec *a, int64_t na, const rec *b, int64_t nb,
+                          rec *out) {
+    if (na + nb <= REC_MERGE_CUTOFF || na == 0 || nb == 0) {
+        rec_merge(a, na, b, nb, out);
+        return;
+    }
+
+    int64_t ma, mb, lo, hi;
+    if (na >= nb) {
+        ma = na / 2;
+        for (lo = 0, hi = nb; lo < hi; ) {
+            int64_t m = lo + (hi - lo) / 2;
+            if (b[m].key < a[ma].key) lo = m + 1;
+            else hi = m;
+        }
+        mb = lo;
+    } else {
+        mb = nb / 2;
+        for (lo = 0, hi = na; lo < hi; ) {
+            int64_t m = lo + (hi - lo) / 2;
+            if (a[m].key <= b[mb].key) lo = m + 1;
+            else hi = m;
+        }
+        ma = lo;
+    }
+
+    #pragma omp task shared(a, b, out) firstprivate(ma, mb)
+    rec_merge_omp(a, ma, b, mb, out);
+
+    #pragma omp task shared(a, b, out) firstprivate(ma, mb, na, nb)
+    rec_merge_omp(a + ma, na - ma, b + mb, nb - mb, out + ma + mb);
+
+    #pragma omp taskwait
+}
+
+/* Every thread mergesorts its static chunk; neighbouring chunks are
+   then merged pairwise, the earlier one always as a */
+static void stable_sort_omp(rec *a, int64_t n, rec *buf) {
+    int T = omp_get_max_threads();
+    if (T > n) T = (int)n;
+
+    int64_t *bounds = malloc((size_t)(T + 1) * sizeof(int64_t));
+    for (int t = 0; t <= T; t++)
+        bounds[t] = n * t / T;
+
+    #pragma omp parallel num_threads(T)
+    {
+        int t = omp_get_thread_num();
+        rec_mergesort(a + bounds[t], bounds[t + 1] - bounds[t], buf + bounds[t]);
+    }
+
+    rec *src = a, *dst = buf;
+    for (int width = 1; width < T; width *= 2) {
+        #pragma omp parallel
+        {
+            #pragma omp single
+            {
+                for (int t = 0; t < T; t += 2 * width) {
+                    int64_t lo  = bounds[t];
+                    int64_t mid = bounds[(t + width < T) ? t + width : T];
+                    int64_t hi  = bounds[(t + 2 * width < T) ? t + 2 * width : T];
+
+                    #pragma omp task firstprivate(lo, mid, hi)
+                    rec_merge_omp(src + lo, mid - lo, src + mid, hi - mid, dst + lo);
+                }
+            }
+        }
+        rec *tmp = src; src = dst; dst = tmp;
+    }
+
+    if (src != a) {
+        #pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < n; i++)
+            a[i] = src[i];
+    }
+
+    free(bounds);
+}
+
+/* ============================
+   Input patterns
+   ============================ */
+static void generate_keys(int *arr, int64_t n, const char *pattern, unsigned int seed) {
+    if (strcmp(pattern, "quasi") == 0) {
+        make_quasi_sorted(arr, n, seed);
+
+    } else if (strcmp(pattern, "desc") == 0) {
+        for (int64_t i = 0; i < n; i++)
+            arr[i] = (int)(n - 1 - i);
+
+    } else {
+        srand(seed);
+        for (int64_t i = 0; i < n; i++)
+            arr[i] = rand() % 100000;
+    }
+}
+
+/* ============================
+   Auto-tuning (cutoff / grain)
+   ============================ */
+#define DEFAULT_CUTOFF 50000
+#define DEFAULT_GRAIN  0
+#define MAX_PROFILE    64
+
+/* Tuned parameters for one thread count. The cutoff is kept as
+   leaves = n / cutoff so that it carries over to other sizes. */
+typedef struct {
+    int threads;
+    int leaves;
+    int grain;
+} tune_entry;
+
+static void default_profile_path(char *path, size_t len) {
+    char host[256] = "localhost";
+    gethostname(host, sizeof(host) - 1);
+    host[sizeof(host) - 1] = '\0';
+    snprintf(path, len, "omp_quicksort.%s.profile", host);
+}
+
+/* Reads "threads leaves grain" lines; returns the number of entries */
+static int read_profile(const char *path, tune_entry *entries) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return 0;
+
+    char line[256];
+    int count = 0;
+    while (count < MAX_PROFILE && fgets(line, sizeof(line), fp)) {
+        tune_entry e;
+        if (line[0] == '#') continue;
+        /* leaves > 0 keeps the derived cutoff >= 1, grain as --grain */
+        if (sscanf(line, "%d %d %d", &e.threads, &e.leaves, &e.grain) == 3 &&
+            e.threads > 0 && e.leaves > 0 && e.grain >= 0)
+            entries[count++] = e;
+    }
+
+    fclose(fp);
+    return count;
+}
+
+static int load_profile(const char *path, int threads, tune_entry *e) {
+    tune_entry entries[MAX_PROFILE];
+    int count = read_profile(path, entries);
+
+    for (int i = 0; i < count; i++) {
+        if (entries[i].threads == threads) {
+            *e = entries[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Replaces (or adds) the entry for e->threads */
+static void save_profile(const char *path, const tune_entry *e) {
+    tune_entry entries[MAX_PROFILE];
+    int count = read_profile(path, entries);
+
+    int i = 0;
+    while (i < count && entries[i].threads != e->threads) i++;
+    if (i < MAX_PROFILE) {
+        entries[i] = *e;
+        if (i == count) count++;
+    }
+
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Error writing %s\n", path);
+        return;
+    }
+    fprintf(fp, "# omp_quicksort tuning profile: threads leaves grain\n");
+    for (i = 0; i < count; i++)
+        fprintf(fp, "%d %d %d\n", entries[i].threads, entries[i].leaves, entries[i].grain);
+    fclose(fp);
+}
+
+/* Best of two parallel sorts of a fresh copy of the sample */
+static double time_trial(const int *sample, int *work, int64_t s, int cutoff, int grain) {
+    double best = 1e30;
+
+    for (int rep = 0; rep < 2; rep++) {
+        memcpy(work, sample, (size_t)s * sizeof(int));
+
+        double t0 = omp_get_wtime();
+        #pragma omp parallel
+        {
+            #pragma omp single
+            quicksort_omp(work, 0, (int)s - 1, cutoff, grain);
+        }
+        double t = omp_get_wtime() - t0;
+
+        if (t < best) best = t;
+    }
+    return best;
+}
+
+/* Calibrates on a strided sample (at most 1M keys) of the real input:
+   sweeps the task cutoff as 1..128 leaves per thread with a fixed
+   grain, then the insertion-sort grain at the best cutoff */
+static tune_entry autotune(const int *arr, int64_t n, int threads) {
+    static const int leaf_factors[] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+    static const int grains[]       = { 0, 8, 16, 32, 64 };
+
+    int64_t s = (n < (1 << 20)) ? n : (1 << 20);
+    int64_t stride = n / s;
+
+    int *sample = malloc((size_t)s * sizeof(int));
+    int *work   = malloc((size_t)s * sizeof(int));
+    for (int64_t i = 0; i < s; i++)
+        sample[i] = arr[i * stride];
+
+    tune_entry best = { threads, threads, 16 };
+    double best_t = 1e30;
+
+    for (size_t i = 0; i < sizeof(leaf_factors) / sizeof(leaf_factors[0]); i++) {
+        int leaves = leaf_factors[i] * threads;
+        int cutoff = (int)((s / leaves > 0) ? s / leaves : 1);
+        double t = time_trial(sample, work, s, cutoff, best.grain);
+        if (t < best_t) {
+            best_t = t;
+            best.leaves = leaves;
+        }
+    }
+
+    int cutoff = (int)((s / best.leaves > 0) ? s / best.leaves : 1);
+    best_t = 1e30;
+    for (size_t i = 0; i < sizeof(grains) / sizeof(grains[0]); i++) {
+        double t = time_trial(sample, work, s, cutoff, grains[i]);
+        if (t < best_t) {
+            best_t = t;
+            best.grain = grains[i];
+        }
+    }
+
+    free(sample);
+    free(work);
+    return best;
+}
+
+/* ============================
+   Benchmark harness (--warmup, --reps)
+   ============================ */
+#ifndef GIT_HASH
+#define GIT_HASH "unknown"
+#endif
+#ifndef BUILD_FLAGS
+#define BUILD_FLAGS "unknown"
+#endif
+
+#define RESULTS_CSV "results.csv"
+
+typedef struct {
+    double min, median, p95, stddev;
+} bench_stats;
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Summary of r timings (sorted in place); p95 is the nearest rank */
+static bench_stats bench_summary(double *t, int r) {
+    qsort(t, (size_t)r, sizeof(double), compare_doubles);
+
+    double mean = 0.0, var = 0.0;
+    for (int i = 0; i < r; i++) mean += t[i];
+    mean /= r;
+    for (int i = 0; i < r; i++) var += (t[i] - mean) * (t[i] - mean);
+
+    bench_stats s;
+    s.min    = t[0];
+    s.median = (r % 2) ? t[r / 2] : 0.5 * (t[r / 2 - 1] + t[r / 2]);
+    s.p95    = t[(int)ceil(0.95 * r) - 1];
+    s.stddev = (r > 1) ? sqrt(var / (r - 1)) : 0.0;
+    return s;
+}
+
+/* Median time plus spread and throughput on stdout */
+static void print_stats(int64_t n, int warmup, int reps, bench_stats s) {
+    double rate = (s.median > 0.0) ? (double)n / s.median : 0.0;
+
+    printf("time = %.6f s\n", s.median);
+    if (reps > 1)
+        printf("reps = %d (+%d warmup): min %.6f s, p95 %.6f s, stddev %.6f s\n",
+               reps, warmup, s.min, s.p95, s.stddev);
+    printf("rate = %.0f keys/s, %.1f MB/s\n", rate, rate * sizeof(int) / 1e6);
+}
+
+/* "model name" from /proc/cpuinfo */
+static void cpu_model(char *buf, size_t len) {
+    snprintf(buf, len, "unknown");
+
+    FILE *fp = fopen("/proc/cpuinfo", "r");
+    if (!fp) return;
+
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        char *v = strchr(line, ':');
+        if (strncmp(line, "model name", 10) == 0 && v) {
+            v += 1 + strspn(v + 1, " \t");
+            v[strcspn(v, "\n")] = '\0';
+            snprintf(buf, len, "%s", v);
+            break;
+        }
+    }
+    fclose(fp);
+}
+
+static void csv_quoted(FILE *fp, const char *s) {
+    fputc('"', fp);
+    for (; *s; s++) {
+        if (*s == '"') fputc('"', fp);
+        fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+/* One row of results.csv, the file shared by all five programs;
+   program-specific settings go to params as key=value;key=value */
+static void write_result(const char *program, int64_t n, const char *pattern,
+                         int threads, int processes, int warmup, int reps,
+                         bench_stats s, int ok, const char *params) {
+    FILE *fp = fopen(RESULTS_CSV, "a");
+    if (!fp) {
+        fprintf(stderr, "Error opening %s\n", RESULTS_CSV);
+        return;
+    }
+
+    if (ftell(fp) == 0)
+        fprintf(fp, "program,n,pattern,threads,processes,warmup,reps,"
+                    "min,median,p95,stddev,keys_per_s,bytes_per_s,sorted,"
+                    "params,git,compiler,flags,cpu\n");
+
+    double rate = (s.median > 0.0) ? (double)n / s.median : 0.0;
+    char cpu[256];
+    cpu_model(cpu, sizeof(cpu));
+
+    fprintf(fp, "%s,%" PRId64 ",%s,%d,%d,%d,%d,%.6f,%.6f,%.6f,%.6f,%.0f,%.0f,%s,",
+            program, n, pattern, threads, processes, warmup, reps,
+            s.min, s.median, s.p95, s.stddev, rate, rate * sizeof(int),
+            ok ? "yes" : "no");
+    csv_quoted(fp, params);
+    fputc(',', fp);
+    csv_quoted(fp, GIT_HASH);
+    fputc(',', fp);
+    csv_quoted(fp, __VERSION__);
+    fputc(',', fp);
+    csv_quoted(fp, BUILD_FLAGS);
+    fputc(',', fp);
+    csv_quoted(fp, cpu);
+    fputc('\n', fp);
+
+    fclose(fp);
+}
+
+/* ============================
+   Phase timers (--phases, --perf)
+   ============================ */
+/* Named spans of a run; with --perf every span also reads cycles, LLC
+   misses and branch misses (perf_event, user space only) */
+enum { PH_GENERATE, PH_SORT, PH_VERIFY, PH_COUNT };
+
+static const char *phase_name[PH_COUNT] = { "generate", "sort", "verify" };
+
+#define PERF_COUNT 3
+static const char *perf_name[PERF_COUNT] = { "cycles", "llc-miss", "br-miss" };
+static int *perf_fd = NULL;      /* [thread * PERF_COUNT + counter] */
+static int  perf_threads = 0;
+
+static double   phase_time[PH_COUNT];
+static double   phase_t0[PH_COUNT];
+static int      phase_used[PH_COUNT];
+static uint64_t phase_ctr[PH_COUNT][PERF_COUNT];
+static uint64_t phase_c0[PH_COUNT][PERF_COUNT];
+
+/* 1/reps inside timed repetitions and 0 in warmups, so the sort phase
+   is reported per run */
+static double phase_weight = 1.0;
+
+static int perf_open_one(int i) {
+    static const uint64_t config[PERF_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.size = sizeof(a);
+    a.type = PERF_TYPE_HARDWARE;
+    a.config = config[i];
+    a.exclude_kernel = 1;
+    a.exclude_hv = 1;
+
+    return (int)syscall(__NR_perf_event_open, &a, 0, -1, -1, 0);
+}
+
+/* Counters are per thread: every thread of the OpenMP team opens its own
+   and reads sum them (threads of the ws engine are not counted) */
+static void perf_open(void) {
+    perf_threads = omp_get_max_threads();
+    perf_fd = malloc((size_t)perf_threads * PERF_COUNT * sizeof(int));
+    for (int i = 0; i < perf_threads * PERF_COUNT; i++)
+        perf_fd[i] = -1;
+
+    #pragma omp parallel num_threads(perf_threads)
+    {
+        int t = omp_get_thread_num();
+        for (int i = 0; i < PERF_COUNT; i++)
+            perf_fd[t * PERF_COUNT + i] = perf_open_one(i);
+    }
+}
+
+static int perf_available(void) {
+    if (!perf_fd) return 0;
+    for (int i = 0; i < perf_threads * PERF_COUNT; i++)
+        if (perf_fd[i] < 0) return 0;
+    return 1;
+}
+
+static void perf_read(uint64_t *v) {
+    for (int i = 0; i < PERF_COUNT; i++) {
+        v[i] = 0;
+        for (int t = 0; t < perf_threads; t++) {
+            uint64_t x;
+            int fd = perf_fd[t * PERF_COUNT + i];
+            if (fd >= 0 && read(fd, &x, sizeof(x)) == sizeof(x))
+                v[i] += x;
+        }
+    }
+}
+
+static void phase_begin(int ph) {
+    perf_read(phase_c0[ph]);
+    phase_t0[ph] = omp_get_wtime();
+}
+
+static void phase_end(int ph) {
+    double t = omp_get_wtime();
+    uint64_t c[PERF_COUNT];
+    perf_read(c);
+
+    phase_used[ph] = 1;
+    phase_time[ph] += (t - phase_t0[ph]) * phase_weight;
+    for (int i = 0; i < PERF_COUNT; i++)
+        phase_ctr[ph][i] += (uint64_t)((double)(c[i] - phase_c0[ph][i]) * phase_weight);
+}
+
+static void phase_report(int perf) {
+    int have = perf_available();
+
+    printf("phases (s):\n");
+    for (int ph = 0; ph < PH_COUNT; ph++) {
+        if (!phase_used[ph]) continue;
+        printf("  %-10s %.6f", phase_name[ph], phase_time[ph]);
+        if (perf && have)
+            for (int i = 0; i < PERF_COUNT; i++)
+                printf("  %s %.3e", perf_name[i], (double)phase_ctr[ph][i]);
+        printf("\n");
+    }
+    if (perf && !have)
+        printf("  perf counters unavailable (perf_event_open failed)\n");
+}
+
+/* ============================
+   Command-line options (--name=value)
+   ============================ */
+static int split_args(int argc, char **argv) {
+    /* moves positional arguments to the front, returns their count */
+    int k = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            char *tmp = argv[i];
+            memmove(&argv[k + 1], &argv[k], (size_t)(i - k) * sizeof(char *));
+            argv[k++] = tmp;
+        }
+    }
+    return k;
+}
+
+static const char *get_opt(int argc, char **argv, const char *name) {
+    size_t len = strlen(name);
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) continue;
+        if (strncmp(argv[i] + 2, name, len) != 0) continue;
+        if (argv[i][2 + len] == '=') return argv[i] + 3 + len;
+        if (argv[i][2 + len] == '\0') return "";
+    }
+    return NULL;
+}
+
+/* ============================
+   Binary keys: mmap input
+   ============================ */
+/* Maps the first n int32 keys of a raw binary file as a private
+   (copy-on-write) mapping, so the sort runs in place without
+   touching the file. */
+static int *map_keys(const char *path, int64_t n, size_t *map_len) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error opening %s\n", path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (int64_t)st.st_size < n * (int64_t)sizeof(int)) {
+        fprintf(stderr, "Error: %s holds fewer than %" PRId64 " keys\n", path, n);
+        close(fd);
+        return NULL;
+    }
+
+    *map_len = (size_t)n * sizeof(int);
+    void *p = mmap(NULL, *map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (p == MAP_FAILED) {
+        fprintf(stderr, "Error mapping %s\n", path);
+        return NULL;
+    }
+
+    madvise(p, *map_len, MADV_SEQUENTIAL);
+    return (int *)p;
+}
+
+/* ============================
+   Binary keys: output
+   ============================ */
+static int write_keys(const char *path, const int *arr, int64_t n) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Error opening %s\n", path);
+        return 0;
+    }
+    size_t w = fwrite(arr, sizeof(int), (size_t)n, fp);
+    fclose(fp);
+    return w == (size_t)n;
+}
+
+/* ============================
+   Top-k / percentile run
+   ============================ */
+/* Times the parallel top-k (mode "topk") or selection (mode "nth"),
+   then a full parallel quicksort of the same input, which also serves
+   as the reference answer. */
+static int run_select(int *arr, int64_t n, const char *pattern,
+                      const char *mode, int64_t k, int cutoff, int grain) {
+    int topk = (strcmp(mode, "topk") == 0);
+    int *out = topk ? buf_alloc(k * sizeof(int)) : NULL;
+    if (topk && !out) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return EXIT_FAILURE;
+    }
+
+    int value;
+    double start = omp_get_wtime();
+    if (topk) {
+        topk_omp(arr, n, k, out);
+        value = out[k - 1];
+    } else {
+        value = select_omp(arr, n, k);
+    }
+    double t = omp_get_wtime() - start;
+
+    start = omp_get_wtime();
+    #pragma omp parallel
+    {
+        #pragma omp single
+        quicksort_omp(arr, 0, (int)n - 1, cutoff, grain);
+    }
+    double t_full = omp_get_wtime() - start;
+
+    int ok = is_sorted(arr, n);
+    if (topk)
+        ok = ok && is_sorted(out, k) && memcmp(out, arr, k * sizeof(int)) == 0;
+    else
+        ok = ok && arr[k] == value;
+
+    printf("OpenMP QuickSort (%s)\n", mode);
+    printf("n = %" PRId64 "\n", n);
+    printf("pattern = %s\n", pattern);
+    printf("threads = %d\n", omp_get_max_threads());
+    printf("k = %" PRId64 "\n", k);
+    printf("value = %d\n", value);
+    printf("time = %.6f s\n", t);
+    printf("full sort time = %.6f s\n", t_full);
+    printf("sorted = %s\n\n", ok ? "yes" : "no");
+
+    char params[128];
+    snprintf(params, sizeof(params), "mode=%s;k=%" PRId64 ";value=%d;full_time=%.6f",
+             mode, k, value, t_full);
+    write_result("omp_quicksort", n, pattern, omp_get_max_threads(), 1, 0, 1,
+                 bench_summary(&t, 1), ok, params);
+
+    free(out);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* ============================
+   Stable sort run (--stable)
+   ============================ */
+/* The keys become records {key, input position} sorted by
+   stable_sort_omp; the keys alone are also sorted once by the multiway
+   merge engine, the unstable run with the same structure, as the
+   reference for the cost of stability */
+static int run_stable(const int *keys, int64_t n, const char *pattern,
+                      int warmup, int reps, int phases, int perf) {
+    rec *a    = buf_alloc(n * sizeof(rec));
+    rec *buf  = buf_alloc(n * sizeof(rec));
+    rec *orig = buf_alloc(n * sizeof(rec));
+    int *tmp  = buf_alloc(2 * n * sizeof(int));
+    double *times = malloc((size_t)reps * sizeof(double));
+    if (!a || !buf || !orig || !tmp || !times) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return EXIT_FAILURE;
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < n; i++)
+        orig[i] = (rec){ keys[i], (int)i };
+    buf_prefault(buf, n * sizeof(rec));
+    buf_prefault(tmp, 2 * n * sizeof(int));
+
+    phase_begin(PH_VERIFY);
+    rec_sum in_sum = rec_sum_of(orig, n);
+    phase_end(PH_VERIFY);
+
+    for (int it = 0; it < warmup + reps; it++) {
+        #pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < n; i++)
+            a[i] = orig[i];
+        phase_weight = (it >= warmup) ? 1.0 / reps : 0.0;
+
+        phase_begin(PH_SORT);
+        double start = omp_get_wtime();
+        stable_sort_omp(a, n, buf);
+        double end = omp_get_wtime();
+        phase_end(PH_SORT);
+
+        if (it >= warmup)
+            times[it - warmup] = end - start;
+    }
+    phase_weight = 1.0;
+
+    memcpy(tmp, keys, n * sizeof(int));
+    double start = omp_get_wtime();
+    mway_sort(tmp, n, tmp + n);
+    double t_unstable = omp_get_wtime() - start;
+
+    phase_begin(PH_VERIFY);
+    int ok = rec_stable(a, n) && rec_sum_equal(in_sum, rec_sum_of(a, n));
+    phase_end(PH_VERIFY);
+
+    bench_stats st = bench_summary(times, reps);
+    int threads = omp_get_max_threads();
+
+    printf("OpenMP QuickSort (stable)\n");
+    printf("n = %" PRId64 "\n", n);
+    printf("pattern = %s\n", pattern);
+    printf("threads = %d\n", threads);
+    printf("strategy = stable mergesort (key + seq records)\n");
+    if (hugepages)
+        printf("pages = %s\n", page_mode());
+    print_stats(n, warmup, reps, st);
+    printf("unstable time = %.6f s (engine merge, keys only), stable cost %.2fx\n",
+           t_unstable, (t_unstable > 0.0) ? st.median / t_unstable : 0.0);
+    if (phases)
+        phase_report(perf);
+    printf("sorted = %s\n\n", ok ? "yes" : "no");
+
+    char params[128];
+    snprintf(params, sizeof(params), "strategy=stable;unstable=%.6f%s", t_unstable,
+             hugepages ? ";pages=huge" : "");
+    write_result("omp_quicksort", n, pattern, threads, 1, warmup, reps, st, ok, params);
+
+    free(times);
+    free(tmp);
+    free(orig);
+    free(buf);
+    free(a);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* ============================
+   Batched sort run (--segments)
+   ============================ */
+/* Boundaries of consecutive segments covering n keys, sizes uniform in
+   [lo, hi] and the last one cut to fit; off gets nseg + 1 entries */
+static int64_t make_segments(int64_t n, int lo, int hi, unsigned int seed,
+                             int64_t **off) {
+    int64_t *o = malloc((size_t)(n / lo + 2) * sizeof(int64_t));
+    unsigned int r = seed ^ 0x9e3779b9u;
+    int64_t s = 0;
+
+    o[0] = 0;
+    while (o[s] < n) {
+        int64_t len = lo + ((hi > lo) ? rand_r(&r) % (hi - lo + 1) : 0);
+        o[s + 1] = (o[s] + len < n) ? o[s] + len : n;
+        s++;
+    }
+    *off = o;
+    return s;
+}
+
+static int segments_sorted(const int *arr, const int64_t *off, int64_t nseg) {
+    int ok = 1;
+    #pragma omp parallel for schedule(dynamic, SEG_CHUNK) reduction(&:ok)
+    for (int64_t s = 0; s < nseg; s++)
+        for (int64_t i = off[s] + 1; i < off[s + 1]; i++)
+            ok &= (arr[i - 1] <= arr[i]);
+    return ok;
+}
+
+/* Batched sort of n keys cut into segments of lo..hi keys, against the
+   same segments sorted by one quicksort_seq call each on one thread */
+static int run_segments(int *arr, int64_t n, const char *pattern, int lo, int hi,
+                        unsigned int seed, int cutoff, int grain,
+                        int warmup, int reps) {
+    int64_t *off;
+    int64_t nseg = make_segments(n, lo, hi, seed, &off);
+    key_sum in_sum = key_sum_of(arr, n);
+
+    int *orig = buf_alloc(n * sizeof(int));
+    double *times = malloc((size_t)reps * sizeof(double));
+    if (!orig || !times) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return EXIT_FAILURE;
+    }
+    memcpy(orig, arr, n * sizeof(int));
+
+    for (int it = 0; it < warmup + reps; it++) {
+        if (it > 0) {
+            #pragma omp parallel for schedule(static)
+            for (int64_t i = 0; i < n; i++)
+                arr[i] = orig[i];
+        }
+
+        double start = omp_get_wtime();
+        segmented_sort(arr, off, nseg, cutoff, grain);
+        double end = omp_get_wtime();
+
+        if (it >= warmup)
+            times[it - warmup] = end - start;
+    }
+
+    int ok = segments_sorted(arr, off, nseg) && key_sum_equal(in_sum, key_sum_of(arr, n));
+
+    /* reference: one call per segment, sorting the pristine copy */
+    double start = omp_get_wtime();
+    for (int64_t s = 0; s < nseg; s++)
+        quicksort_seq(orig + off[s], 0, (int)(off[s + 1] - off[s]) - 1, grain);
+    double t_call = omp_get_wtime() - start;
+    ok = ok && memcmp(orig, arr, n * sizeof(int)) == 0;
+
+    bench_stats st = bench_summary(times, reps);
+    double seg_rate = (st.median > 0.0) ? (double)nseg / st.median : 0.0;
+    int threads = omp_get_max_threads();
+
+    printf("OpenMP QuickSort (segments)\n");
+    printf("n = %" PRId64 "\n", n);
+    printf("pattern = %s\n", pattern);
+    printf("threads = %d\n", threads);
+    printf("segments = %" PRId64 " (%d..%d keys)\n", nseg, lo, hi);
+    if (hugepages)
+        printf("pages = %s\n", page_mode());
+    print_stats(n, warmup, reps, st);
+    printf("segment rate = %.0f segments/s\n", seg_rate);
+    printf("per-call time = %.6f s (quicksort per segment, 1 thread), speedup %.2fx\n",
+           t_call, (st.median > 0.0) ? t_call / st.median : 0.0);
+    printf("sorted = %s\n\n", ok ? "yes" : "no");
+
+    char params[256];
+    snprintf(params, sizeof(params),
+             "mode=segments;seg=%d:%d;count=%" PRId64 ";seg_per_s=%.0f;per_call=%.6f%s",
+             lo, hi, nseg, seg_rate, t_call, hugepages ? ";pages=huge" : "");
+    write_result("omp_quicksort", n, pattern, threads, 1, warmup, reps, st, ok, params);
+
+    free(times);
+    free(orig);
+    free(off);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* ============================
+   Service mode (--serve)
+   ============================ */
+/* Keeps the process, the OpenMP team and the key buffers alive across
+   many sorts. Jobs are read one per line from a job file, or from stdin
+   with --serve=- (a FIFO then keeps the service up between clients):
+
+       <n> [pattern] [seed] [--input=keys.bin] [--engine=tasks|ws|merge] [--adaptive]
+
+   Blank lines and lines starting with # are skipped; "quit" or end of
+   input stops the service. Startup (runtime, thread team, profile) is
+   reported once; every job reports its latency, from reading the line
+   to the verified result, and the sort time inside it. */
+#define JOB_LINE 512
+#define JOB_ARGS 16
+
+/* Grow-only key buffer, faulted in when it grows, so a job no larger
+   than an earlier one touches no new pages */
+typedef struct {
+    int    *p;
+    int64_t cap;
+} key_arena;
+
+static int *arena_reserve(key_arena *a, int64_t n) {
+    if (n <= a->cap)
+        return a->p;
+    free(a->p);
+    a->cap = 0;
+    if (!(a->p = buf_alloc((size_t)n * sizeof(int))))
+        return NULL;
+    buf_prefault(a->p, (size_t)n * sizeof(int));
+    a->cap = n;
+    return a->p;
+}
+
+/* Splits a job line in place into argv form (jargv[0] is a placeholder) */
+static int job_args(char *line, char **jargv) {
+    static char name[] = "job";
+    int jc = 0;
+    jargv[jc++] = name;
+    for (char *tok = strtok(line, " \t\r\n"); tok && jc < JOB_ARGS;
+         tok = strtok(NULL, " \t\r\n"))
+        jargv[jc++] = tok;
+    return jc;
+}
+
+static int serve_jobs(const char *path, double t_launch) {
+    FILE *jobs = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+    if (!jobs) {
+        fprintf(stderr, "Error opening %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    /* One-time startup: spin the team up, load the machine profile */
+    int threads = omp_get_max_threads();
+    #pragma omp parallel
+    {
+        (void)omp_get_thread_num();
+    }
+
+    char profile[512];
+    default_profile_path(profile, sizeof(profile));
+    tune_entry te;
+    int have_profile = load_profile(profile, threads, &te);
+
+    key_arena data = { NULL, 0 }, scratch = { NULL, 0 };
+    ws_stats *wst = malloc((size_t)threads * sizeof(ws_stats));
+
+    double startup = omp_get_wtime() - t_launch;
+
+    printf("OpenMP QuickSort (service)\n");
+    printf("threads = %d\n", threads);
+    printf("startup = %.6f s\n", startup);
+    fflush(stdout);
+
+    int cap = 64, seen = 0, done = 0, failed = 0;
+    double *lat = malloc((size_t)cap * sizeof(double));
+    char line[JOB_LINE];
+
+    while (fgets(line, sizeof(line), jobs)) {
+        double t0 = omp_get_wtime();
+
+        char *jargv[JOB_ARGS];
+        int jc = job_args(line, jargv);
+        if (jc < 2 || jargv[1][0] == '#')
+            continue;
+        if (strcmp(jargv[1], "quit") == 0)
+            break;
+        seen++;
+
+        int npos = split_args(jc, jargv);
+        int64_t n = (npos >= 2) ? atoll(jargv[1]) : 0;
+        if (n <= 0 || n > INT_MAX) {
+            fprintf(stderr, "job %d: n must be in [1, %d]\n", seen, INT_MAX);
+            failed++;
+            continue;
+        }
+
+        const char *pattern = (npos >= 3) ? jargv[2] : "random";
+        unsigned int seed = (npos >= 4)
+                            ? (unsigned int)strtoul(jargv[3], NULL, 10)
+                            : (unsigned int)time(NULL);
+        const char *input = get_opt(jc, jargv, "input");
+        int adaptive = (get_opt(jc, jargv, "adaptive") != NULL);
+        const char *engine = get_opt(jc, jargv, "engine");
+        if (engine && strcmp(engine, "tasks") != 0 && strcmp(engine, "ws") != 0 &&
+            strcmp(engine, "merge") != 0) {
+            fprintf(stderr, "job %d: unknown engine '%s' (tasks, ws or merge)\n", seen, engine);
+            failed++;
+            continue;
+        }
+        if (!engine || adaptive)
+            engine = "tasks";
+
+        int *arr = arena_reserve(&data, n);
+        if (!arr) {
+            fprintf(stderr, "job %d: allocation failed\n", seen);
+            failed++;
+            continue;
+        }
+
+        /* merge scratch for the adaptive and multiway engines */
+        int *buf = NULL;
+        if (adaptive || strcmp(engine, "merge") == 0) {
+            buf = arena_reserve(&scratch, n);
+            if (!buf) {
+                fprintf(stderr, "job %d: allocation failed\n", seen);
+                failed++;
+                continue;
+            }
+        }
+
+        if (input) {
+            size_t map_len = 0;
+            int *keys = map_keys(input, n, &map_len);
+            if (!keys) {
+                failed++;
+                continue;
+            }
+            memcpy(arr, keys, (size_t)n * sizeof(int));
+            munmap(keys, map_len);
+            pattern = "file";
+        } else {
+            generate_keys(arr, n, pattern, seed);
+        }
+        key_sum in_sum = key_sum_of(arr, n);
+
+        int cutoff = DEFAULT_CUTOFF, grain = DEFAULT_GRAIN;
+        if (have_profile) {
+            cutoff = (int)((n / te.leaves > 0) ? n / te.leaves : 1);
+            grain  = te.grain;
+        }
+
+        double s0 = omp_get_wtime();
+        if (adaptive) {
+            int64_t inv, runs;
+            adaptive_sort_omp(arr, n, buf, cutoff, grain, &inv, &runs);
+        } else if (strcmp(engine, "ws") == 0) {
+            quicksort_ws(arr, n, threads, cutoff, grain, NULL, wst);
+        } else if (strcmp(engine, "merge") == 0) {
+            mway_sort(arr, n, buf);
+        } else {
+            #pragma omp parallel
+            {
+                #pragma omp single
+                quicksort_omp(arr, 0, (int)n - 1, cutoff, grain);
+            }
+        }
+        double t_sort = omp_get_wtime() - s0;
+
+        int ok = is_sorted(arr, n) && key_sum_equal(in_sum, key_sum_of(arr, n));
+        double t_job = omp_get_wtime() - t0;
+
+        done++;
+        printf("job %d: n = %" PRId64 ", pattern = %s, engine = %s%s, "
+               "latency = %.6f s, sort = %.6f s, sorted = %s\n",
+               seen, n, pattern, engine, adaptive ? " (adaptive)" : "",
+               t_job, t_sort, ok ? "yes" : "no");
+        fflush(stdout);
+
+        /* results.csv row: the timing columns hold the sort */
+        char params[160];
+        snprintf(params, sizeof(params),
+                 "mode=serve;job=%d;engine=%s%s;startup=%.6f;latency=%.6f",
+                 seen, engine, adaptive ? ";strategy=adaptive" : "", startup, t_job);
+        write_result("omp_quicksort", n, pattern, threads, 1, 0, 1,
+                     bench_summary(&t_sort, 1), ok, params);
+
+        if (done == cap)
+            lat = realloc(lat, (size_t)(cap *= 2) * sizeof(double));
+        lat[done - 1] = t_job;
+        if (!ok)
+            failed++;
+    }
+
+    if (done > 0) {
+        bench_stats st = bench_summary(lat, done);
+        printf("jobs = %d, failed = %d\n", seen, failed);
+        printf("latency = %.6f s median, %.6f s min, %.6f s p95\n\n",
+               st.median, st.min, st.p95);
+    }
+
+    if (jobs != stdin)
+        fclose(jobs);
+    free(lat);
+    free(wst);
+    free(data.p);
+    free(scratch.p);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* ============================
+             MAIN
+   ============================ */
+int main(int argc, char **argv) {
+
+    double t_launch = omp_get_wtime();
+    int npos = split_args(argc, argv);
+
+    /* Service mode: no positional arguments, jobs come from a file */
+    const char *serve = get_opt(argc, argv, "serve");
+    if (serve) {
+        hugepages = (get_opt(argc, argv, "hugepages") != NULL);
+        return serve_jobs(*serve ? serve : "-", t_launch);
+    }
+
+    if (npos < 2) {
+        fprintf(stderr,
+            "Usage: %s <n> [pattern=random|quasi|desc] [seed]"
+            " [--input=keys.bin] [--output=sorted.bin]"
+            " [--topk=K | --percentile=P] [--adaptive]"
+            " [--tune] [--profile=FILE] [--cutoff=C] [--grain=G]"
+            " [--engine=tasks|ws|merge] [--numa] [--hugepages]"
+            " [--segments=LO[:HI]] [--stable] [--warmup=W] [--reps=R] [--phases] [--perf]\n"
+            "       %s --serve=jobs.txt|- [--hugepages]\n",
+            argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int64_t n = atoll(argv[1]);
+    if (n <= 0) {
+        fprintf(stderr, "Error: n must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    const char *pattern = "random";
+    if (npos >= 3)
+        pattern = argv[2];
+
+    const char *input  = get_opt(argc, argv, "input");
+    const char *output = get_opt(argc, argv, "output");
+    if (input)
+        pattern = "file";
+
+    hugepages = (get_opt(argc, argv, "hugepages") != NULL);
+
+    /* W untimed warmup runs, then R timed repetitions on the same input */
+    const char *opt;
+    int warmup = (opt = get_opt(argc, argv, "warmup")) != NULL ? atoi(opt) : 0;
+    int reps   = (opt = get_opt(argc, argv, "reps"))   != NULL ? atoi(opt) : 1;
+    if (warmup < 0 || reps < 1) {
+        fprintf(stderr, "Error: --warmup must be >= 0 and --reps >= 1\n");
+        return EXIT_FAILURE;
+    }
+
+    /* Per-phase report; --perf adds hardware counters to it */
+    int perf   = (get_opt(argc, argv, "perf") != NULL);
+    int phases = perf || (get_opt(argc, argv, "phases") != NULL);
+    if (perf)
+        perf_open();
+
+    /* Top-k (k smallest, sorted) or percentile (single k-th key) */
+    const char *select_mode = NULL;
+    int64_t k = 0;
+    if ((opt = get_opt(argc, argv, "topk")) != NULL) {
+        select_mode = "topk";
+        k = atoll(opt);
+        if (k < 1 || k > n) {
+            fprintf(stderr, "Error: k must be in [1, n]\n");
+            return EXIT_FAILURE;
+        }
+    } else if ((opt = get_opt(argc, argv, "percentile")) != NULL) {
+        select_mode = "nth";
+        double p = atof(opt);
+        if (p < 0.0 || p > 100.0) {
+            fprintf(stderr, "Error: percentile must be in [0, 100]\n");
+            return EXIT_FAILURE;
+        }
+        k = (int64_t)(p / 100.0 * (double)(n - 1));
+    }
+
+    unsigned int seed = (npos >= 4)
+                          ? (unsigned int)strtoul(argv[3], NULL, 10)
+                          : (unsigned int)time(NULL);
+
+    srand(seed);
+
+    /* NUMA: threads pinned node by node (multi-node only), pages
+       first-touched by the thread whose static block holds them */
+    int numa = (get_opt(argc, argv, "numa") != NULL);
+    int nodes = 1;
+    int *numa_cpus = NULL;
+
+    if (numa) {
+        nodes = numa_nodes();
+        if (nodes > 1) {
+            numa_cpus = malloc((size_t)omp_get_max_threads() * sizeof(int));
+            numa_thread_cpus(numa_cpus, omp_get_max_threads(), nodes);
+
+            #pragma omp parallel
+            pin_to_cpu(numa_cpus[omp_get_thread_num()]);
+        }
+    }
+
+    double t_io = 0.0;
+
+    int *arr = NULL;
+    size_t map_len = 0;
+
+    if (input) {
+        double io_start = omp_get_wtime();
+
+        arr = map_keys(input, n, &map_len);
+        if (!arr)
+            return EXIT_FAILURE;
+
+        /* the mapping is private: one write per page takes the
+           copy-on-write fault here, so it is not charged to the sort */
+        volatile int *page = arr;
+        #pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < n; i += 4096 / sizeof(int))
+            page[i] = page[i];
+        if (n > 0)
+            page[n - 1] = page[n - 1];
+
+        t_io += omp_get_wtime() - io_start;
+
+    } else {
+        arr = buf_alloc(n * sizeof(int));
+        if (!arr) {
+            fprintf(stderr, "Memory allocation failed\n");
+            return EXIT_FAILURE;
+        }
+
+        if (numa)
+            buf_prefault(arr, n * sizeof(int));
+
+        /* Generate data */
+        phase_begin(PH_GENERATE);
+        generate_keys(arr, n, pattern, seed);
+        phase_end(PH_GENERATE);
+    }
+
+    int threads = omp_get_max_threads();
+    int cutoff  = DEFAULT_CUTOFF;
+    int grain   = DEFAULT_GRAIN;
+
+    /* Task cutoff and base-case grain: --tune calibrates and saves them,
+       otherwise the machine profile is used when it has this thread count */
+    char profile[512];
+    if ((opt = get_opt(argc, argv, "profile")) != NULL && *opt)
+        snprintf(profile, sizeof(profile), "%s", opt);
+    else
+        default_profile_path(profile, sizeof(profile));
+
+    const char *tuning = "default";
+    double t_tune = 0.0;
+    tune_entry te;
+    int tune = (get_opt(argc, argv, "tune") != NULL);
+
+    if (tune) {
+        double tune_start = omp_get_wtime();
+        te = autotune(arr, n, threads);
+        t_tune = omp_get_wtime() - tune_start;
+        save_profile(profile, &te);
+        tuning = "tuned";
+    } else if (load_profile(profile, threads, &te)) {
+        tuning = "profile";
+    }
+
+    if (strcmp(tuning, "default") != 0) {
+        cutoff = (int)((n / te.leaves > 0) ? n / te.leaves : 1);
+        grain  = te.grain;
+    }
+
+    if ((opt = get_opt(argc, argv, "cutoff")) != NULL) {
+        cutoff = atoi(opt);
+        tuning = "manual";
+    }
+    if ((opt = get_opt(argc, argv, "grain")) != NULL) {
+        grain = atoi(opt);
+        tuning = "manual";
+    }
+    if (cutoff < 0 || grain < 0) {
+        /* a negative cutoff never reaches the sequential base case */
+        fprintf(stderr, "Error: --cutoff and --grain must be >= 0\n");
+        return EXIT_FAILURE;
+    }
+
+    if (select_mode) {
+        int rc = run_select(arr, n, pattern, select_mode, k, cutoff, grain);
+        if (input)
+            munmap(arr, map_len);
+        else
+            free(arr);
+        return rc;
+    }
+
+    /* Stable mode: records sorted by key, equal keys in input order */
+    if (get_opt(argc, argv, "stable") != NULL) {
+        int rc = run_stable(arr, n, pattern, warmup, reps, phases, perf);
+        if (input)
+            munmap(arr, map_len);
+        else
+            free(arr);
+        return rc;
+    }
+
+    /* Batched sort: n keys cut into independent segments of LO..HI keys */
+    if ((opt = get_opt(argc, argv, "segments")) != NULL) {
+        int lo = atoi(opt);
+        const char *colon = strchr(opt, ':');
+        int hi = colon ? atoi(colon + 1) : lo;
+        int rc = EXIT_FAILURE;
+        if (lo < 1 || hi < lo)
+            fprintf(stderr, "Error: --segments=LO[:HI] needs 1 <= LO <= HI\n");
+        else
+            rc = run_segments(arr, n, pattern, lo, hi, seed, cutoff, grain, warmup, reps);
+        if (input)
+            munmap(arr, map_len);
+        else
+            free(arr);
+        return rc;
+    }
+
+    int adaptive = (get_opt(argc, argv, "adaptive") != NULL);
+    const char *strategy = "quicksort";
+    int64_t inv = 0, runs = 0;
+
+    /* tasks: OpenMP tasks; ws: work-stealing pthreads; merge: multiway
+       mergesort (the adaptive front end always uses tasks) */
+    const char *engine = get_opt(argc, argv, "engine");
+    if (!engine || adaptive || (strcmp(engine, "ws") != 0 && strcmp(engine, "merge") != 0))
+        engine = "tasks";
+    ws_stats *wst = NULL;
+    if (strcmp(engine, "ws") == 0)
+        wst = malloc((size_t)threads * sizeof(ws_stats));
+    int mway = (strcmp(engine, "merge") == 0);
+
+    /* scratch for the natural and multiway merges, faulted in outside
+       the timer */
+    int *scratch = NULL;
+    if ((adaptive || mway) && (scratch = buf_alloc(n * sizeof(int))) != NULL)
+        buf_prefault(scratch, n * sizeof(int));
+    if (mway && !scratch) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return EXIT_FAILURE;
+    }
+
+    /* checksum of the input, compared with the sorted output */
+    phase_begin(PH_VERIFY);
+    key_sum in_sum = key_sum_of(arr, n);
+    phase_end(PH_VERIFY);
+
+    /* pristine input, restored before every run after the first */
+    int *orig = NULL;
+    if (warmup + reps > 1) {
+        orig = buf_alloc(n * sizeof(int));
+        if (!orig) {
+            fprintf(stderr, "Memory allocation failed\n");
+            return EXIT_FAILURE;
+        }
+        memcpy(orig, arr, n * sizeof(int));
+    }
+
+    double *times = malloc((size_t)reps * sizeof(double));
+
+    for (int it = 0; it < warmup + reps; it++) {
+        double start = 0.0, end = 0.0;
+
+        if (it > 0) {
+            #pragma omp parallel for schedule(static)
+            for (int64_t i = 0; i < n; i++)
+                arr[i] = orig[i];
+        }
+        phase_weight = (it >= warmup) ? 1.0 / reps : 0.0;
+        phase_begin(PH_SORT);
+
+        if (adaptive) {
+            start = omp_get_wtime();
+            strategy = adaptive_sort_omp(arr, n, scratch, cutoff, grain, &inv, &runs);
+            end = omp_get_wtime();
+        } else if (wst) {
+            start = omp_get_wtime();
+            quicksort_ws(arr, n, threads, cutoff, grain, numa_cpus, wst);
+            end = omp_get_wtime();
+        } else if (mway) {
+            start = omp_get_wtime();
+            mway_sort(arr, n, scratch);
+            end = omp_get_wtime();
+        } else {
+            #pragma omp parallel
+            {
+                #pragma omp single
+                {
+                    start = omp_get_wtime();
+                    quicksort_omp(arr, 0, (int)n - 1, cutoff, grain);
+                    #pragma omp taskwait
+                    end = omp_get_wtime();
+                }
+            }
+        }
+
+        phase_end(PH_SORT);
+        if (it >= warmup)
+            times[it - warmup] = end - start;
+    }
+    phase_weight = 1.0;
+
+    free(scratch);
+    free(orig);
+
+    bench_stats st = bench_summary(times, reps);
+    free(times);
+
+    phase_begin(PH_VERIFY);
+    int ok = is_sorted(arr, n) && key_sum_equal(in_sum, key_sum_of(arr, n));
+    phase_end(PH_VERIFY);
+
+    int written = 1;
+    if (output) {
+        double io_start = omp_get_wtime();
+        written = write_keys(output, arr, n);
+        t_io += omp_get_wtime() - io_start;
+    }
+
+    printf("OpenMP QuickSort\n");
+    printf("n = %" PRId64 "\n", n);
+    printf("pattern = %s\n", pattern);
+    printf("threads = %d\n", threads);
+    if (adaptive) {
+        printf("inversions = %" PRId64 "\n", inv);
+        printf("runs = %" PRId64 "\n", runs);
+    }
+    printf("strategy = %s\n", strategy);
+    printf("engine = %s\n", engine);
+    printf("cutoff = %d, grain = %d (%s)\n", cutoff, grain, tuning);
+    if (t_tune > 0.0)
+        printf("tune time = %.6f s -> %s\n", t_tune, profile);
+    if (hugepages)
+        printf("pages = %s\n", page_mode());
+    print_stats(n, warmup, reps, st);
+    if (input || output)
+        printf("io time = %.6f s\n", t_io);
+    if (numa) {
+        printf("numa = %d node%s%s\n", nodes, nodes > 1 ? "s" : "",
+               nodes > 1 ? ", threads pinned" : " (no-op)");
+        numa_bandwidth(arr, n, nodes);
+    }
+    if (wst) {
+        for (int i = 0; i < threads; i++)
+            printf("  worker %d: node %d, tasks %" PRId64 ", steals %" PRId64
+                   "/%" PRId64 ", idle %.6f s\n",
+                   wst[i].id, wst[i].node, wst[i].tasks, wst[i].steals,
+                   wst[i].attempts, wst[i].idle);
+        free(wst);
+    }
+    if (phases)
+        phase_report(perf);
+    printf("sorted = %s\n\n", ok ? "yes" : "no");
+
+    char params[256];
+    snprintf(params, sizeof(params), "strategy=%s;cutoff=%d;grain=%d;engine=%s%s%s",
+             strategy, cutoff, grain, engine,
+             numa ? ";numa=on" : "", hugepages ? ";pages=huge" : "");
+    /* a --tune run is calibration, not a benchmark sample */
+    if (!tune)
+        write_result("omp_quicksort", n, pattern, threads, 1, warmup, reps, st, ok, params);
+
+    if (input)
+        munmap(arr, map_len);
+    else
+        free(arr);
+    free(numa_cpus);
+    free(perf_fd);
+
+    return (ok && written) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -1,8 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <stdint.h>
 #include <inttypes.h>
 #include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <sys/stat.h>
 
 /* ============================
    Swap
@@ -52,6 +60,288 @@ static void quicksort(int *arr, int low, int high) {
     }
 }
 
+/* ============================
+   Aligned / huge-page buffers
+   ============================ */
+#define HUGE_PAGE ((size_t)2 << 20)
+
+static int hugepages = 0;        /* --hugepages */
+static int hugepages_denied = 0; /* madvise refused or THP disabled */
+
+/* 64-byte aligned buffer; with --hugepages, buffers of at least one
+   huge page are 2 MB aligned and advised for transparent huge pages
+   (they stay on 4 KB pages if THP is off) */
+static void *buf_alloc(size_t nbytes) {
+    int huge = hugepages && nbytes >= HUGE_PAGE;
+    size_t align = huge ? HUGE_PAGE : 64;
+    size_t len = (nbytes + align - 1) / align * align;
+    if (len == 0) len = align;
+
+    void *p = NULL;
+    if (posix_memalign(&p, align, len) != 0)
+        return NULL;
+
+    if (huge && madvise(p, len, MADV_HUGEPAGE) != 0)
+        hugepages_denied = 1;
+    return p;
+}
+
+/* Writes one byte per page so first-touch faults happen here and not
+   inside a timed region */
+static void buf_prefault(void *p, size_t nbytes) {
+    volatile char *c = p;
+    for (size_t i = 0; i < nbytes; i += 4096)
+        c[i] = 0;
+}
+
+static const char *page_mode(void) {
+    if (!hugepages) return "4k";
+
+    FILE *fp = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (fp) {
+        char line[128] = "";
+        if (fgets(line, sizeof(line), fp) && strstr(line, "[never]"))
+            hugepages_denied = 1;
+        fclose(fp);
+    }
+    return hugepages_denied ? "4k (huge pages unavailable)" : "huge";
+}
+
+/* ============================
+   Adaptive front end (presortedness)
+   ============================ */
+#define MIN_RUN            32   /* short runs are extended to this by insertion */
+#define NEARLY_SORTED_RUN  8    /* mean run length that selects the natural merge */
+
+static void reverse_range(int *arr, int64_t i, int64_t j) {
+    while (i < j) {
+        int t = arr[i];
+        arr[i++] = arr[j];
+        arr[j--] = t;
+    }
+}
+
+/* One pass over arr[lo..hi): reverses every strictly descending run in
+   place, counts the adjacent inversions of the input (*inv) and the
+   run breaks left after reversal (*breaks, so runs = breaks + 1) */
+static void presort_pass(int *arr, int64_t lo, int64_t hi,
+                         int64_t *inv, int64_t *breaks) {
+    int64_t d = 0, b = 0;
+    int last_orig = 0;
+
+    for (int64_t i = lo; i < hi; ) {
+        int first = arr[i];
+        int last;
+        int64_t j = i + 1;
+
+        if (j < hi && arr[i] > arr[j]) {
+            while (j < hi && arr[j - 1] > arr[j]) j++;
+            d += j - i - 1;
+            last = arr[j - 1];
+            reverse_range(arr, i, j - 1);
+        } else {
+            while (j < hi && arr[j - 1] <= arr[j]) j++;
+            last = arr[j - 1];
+        }
+
+        if (i > lo) {
+            d += (last_orig > first);
+            b += (arr[i - 1] > arr[i]);
+        }
+
+        last_orig = last;
+        i = j;
+    }
+
+    *inv    = d;
+    *breaks = b;
+}
+
+/* Ascending run starting at lo, extended to MIN_RUN keys by insertion */
+static int64_t next_run(int *arr, int64_t lo, int64_t hi) {
+    int64_t i = lo + 1;
+    while (i < hi && arr[i - 1] <= arr[i]) i++;
+
+    int64_t end = (hi - lo < MIN_RUN) ? hi : lo + MIN_RUN;
+    for (; i < end; i++) {
+        int x = arr[i];
+        int64_t j = i;
+        while (j > lo && arr[j - 1] > x) {
+            arr[j] = arr[j - 1];
+            j--;
+        }
+        arr[j] = x;
+    }
+
+    return i - lo;
+}
+
+/* Merges the adjacent sorted runs arr[lo..mid) and arr[mid..hi);
+   the left run is copied to buf[lo..mid) first */
+static void merge_runs(int *arr, int64_t lo, int64_t mid, int64_t hi, int *buf) {
+    memcpy(buf + lo, arr + lo, (size_t)(mid - lo) * sizeof(int));
+
+    int64_t i = lo, j = mid, k = lo;
+    while (i < mid && j < hi)
+        arr[k++] = (buf[i] <= arr[j]) ? buf[i++] : arr[j++];
+    while (i < mid)
+        arr[k++] = buf[i++];
+}
+
+/* Powersort node power of the boundary between runs [s1, s1+n1) and
+   [s1+n1, s1+n1+n2) in an array of n keys */
+static int node_power(int64_t s1, int64_t n1, int64_t n2, int64_t n) {
+    int64_t a = 2 * s1 + n1;
+    int64_t b = a + n1 + n2;
+    int64_t m = 2 * n;
+
+    for (int l = 1; ; l++) {
+        a <<= 1;
+        b <<= 1;
+        int abit = (a >= m), bbit = (b >= m);
+        if (abit != bbit) return l;
+        if (abit) {
+            a -= m;
+            b -= m;
+        }
+    }
+}
+
+/* Natural mergesort of arr[lo..hi) with the powersort merge policy */
+static void natural_mergesort(int *arr, int64_t lo, int64_t hi, int *buf) {
+    struct { int64_t start, len; int power; } stack[128];
+    int top = 0;
+
+    if (hi - lo < 2) return;
+
+    int64_t s1 = lo;
+    int64_t n1 = next_run(arr, s1, hi);
+
+    while (s1 + n1 < hi) {
+        int64_t s2 = s1 + n1;
+        int64_t n2 = next_run(arr, s2, hi);
+        int p = node_power(s1 - lo, n1, n2, hi - lo);
+
+        while (top > 0 && stack[top - 1].power > p) {
+            top--;
+            merge_runs(arr, stack[top].start, s1, s1 + n1, buf);
+            n1 += stack[top].len;
+            s1  = stack[top].start;
+        }
+
+        stack[top].start = s1;
+        stack[top].len   = n1;
+        stack[top].power = p;
+        top++;
+
+        s1 = s2;
+        n1 = n2;
+    }
+
+    while (top > 0) {
+        top--;
+        merge_runs(arr, stack[top].start, s1, s1 + n1, buf);
+        n1 += stack[top].len;
+        s1  = stack[top].start;
+    }
+}
+
+/* ============================
+   Adaptive sort
+   ============================ */
+/* Reverses descending runs, then picks the engine from the run count:
+   nothing left to do, natural merge for long runs, quicksort otherwise.
+   buf (n keys, may be NULL) is the merge scratch. Returns the strategy
+   name. */
+static const char *adaptive_sort(int *arr, int64_t n, int *buf,
+                                 int64_t *inv, int64_t *runs) {
+    int64_t breaks;
+    presort_pass(arr, 0, n, inv, &breaks);
+    *runs = breaks + 1;
+
+    if (*runs == 1)
+        return "presorted";
+
+    if (buf && n / *runs >= NEARLY_SORTED_RUN) {
+        natural_mergesort(arr, 0, n, buf);
+        return "natural";
+    }
+
+    quicksort(arr, 0, (int)n - 1);
+    return "quicksort";
+}
+
+/* ============================
+   Selection (Floyd-Rivest nth_element)
+   ============================ */
+/* Moves the k-th smallest element of arr[low..high] to index k, with
+   nothing greater before it and nothing smaller after it. Large ranges
+   are first narrowed around k by recursing on a sample (Floyd-Rivest);
+   if the partitions keep going badly the range is just sorted
+   (introselect-style depth budget). */
+static void select_nth(int *arr, int low, int high, int k) {
+    int budget = 8;
+    for (int len = high - low + 1; len > 1; len >>= 1)
+        budget += 2;
+
+    while (high > low) {
+        if (high - low > 600) {
+            double n  = high - low + 1;
+            double i  = k - low + 1;
+            double z  = log(n);
+            double s  = 0.5 * exp(2.0 * z / 3.0);
+            double sd = 0.5 * sqrt(z * s * (n - s) / n) * (i < n / 2 ? -1 : 1);
+            int new_low  = (int)(k - i * s / n + sd);
+            int new_high = (int)(k + (n - i) * s / n + sd);
+            select_nth(arr,
+                       new_low  > low  ? new_low  : low,
+                       new_high < high ? new_high : high, k);
+        }
+
+        if (--budget < 0) {
+            quicksort(arr, low, high);
+            return;
+        }
+
+        int t = arr[k];
+        int i = low, j = high;
+
+        swap(&arr[low], &arr[k]);
+        if (arr[high] > t)
+            swap(&arr[high], &arr[low]);
+
+        while (i < j) {
+            swap(&arr[i], &arr[j]);
+            i++;
+            j--;
+            while (arr[i] < t) i++;
+            while (arr[j] > t) j--;
+        }
+
+        if (arr[low] == t) {
+            swap(&arr[low], &arr[j]);
+        } else {
+            j++;
+            swap(&arr[j], &arr[high]);
+        }
+
+        if (j <= k) low  = j + 1;
+        if (k <= j) high = j - 1;
+    }
+}
+
+/* ============================
+   Partial sort (k smallest, in order)
+   ============================ */
+static void partial_sort(int *arr, int n, int k) {
+    if (k < n) {
+        select_nth(arr, 0, n - 1, k - 1);
+        quicksort(arr, 0, k - 2);   /* arr[k - 1] is already in place */
+    } else {
+        quicksort(arr, 0, n - 1);
+    }
+}
+
 /* ============================
    Check sorted
    ============================ */
@@ -62,6 +352,88 @@ static int is_sorted(const int *arr, size_t n) {
     return 1;
 }
 
+/* ============================
+   Key checksum (permutation check)
+   ============================ */
+/* Multiset fingerprint: count, sum, xor, a splitmix-mixed sum and the
+   product of (R - key) mod 2^61 - 1, i.e. the polynomial prod(R - x)
+   evaluated at a fixed point. None of them depends on the order, so
+   they match before and after the sort unless keys were lost,
+   duplicated or altered; two different multisets agree on the product
+   with probability at most n / 2^61. */
+typedef struct {
+    uint64_t count, sum, xr, mix, poly;
+} key_sum;
+
+#define KEY_SUM_BLOCK 4096
+#define POLY_P ((UINT64_C(1) << 61) - 1)
+#define POLY_R UINT64_C(0x1d8e4e27c47d124f)   /* < POLY_P, > any key */
+
+static inline uint64_t key_mix(int key) {
+    uint64_t z = (uint64_t)(uint32_t)key + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t mulmod61(uint64_t a, uint64_t b) {
+    unsigned __int128 z = (unsigned __int128)a * b;
+    uint64_t s = ((uint64_t)z & POLY_P) + (uint64_t)(z >> 61);
+    return (s >= POLY_P) ? s - POLY_P : s;
+}
+
+/* Product over one block with four independent chains, so the
+   multiplies overlap instead of waiting on each other */
+static uint64_t poly_block(const int *arr, int64_t n) {
+    uint64_t p0 = 1, p1 = 1, p2 = 1, p3 = 1;
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        p0 = mulmod61(p0, POLY_R - (uint32_t)arr[i]);
+        p1 = mulmod61(p1, POLY_R - (uint32_t)arr[i + 1]);
+        p2 = mulmod61(p2, POLY_R - (uint32_t)arr[i + 2]);
+        p3 = mulmod61(p3, POLY_R - (uint32_t)arr[i + 3]);
+    }
+    for (; i < n; i++)
+        p0 = mulmod61(p0, POLY_R - (uint32_t)arr[i]);
+    return mulmod61(mulmod61(p0, p1), mulmod61(p2, p3));
+}
+
+/* Blocked so the product re-reads keys from L1 right after the
+   vectorized sum/xor/mix pass */
+static key_sum key_sum_of(const int *arr, int64_t n) {
+    uint64_t sum = 0, xr = 0, mix = 0, poly = 1;
+    for (int64_t b = 0; b < n; b += KEY_SUM_BLOCK) {
+        int64_t e = (b + KEY_SUM_BLOCK < n) ? b + KEY_SUM_BLOCK : n;
+        for (int64_t i = b; i < e; i++) {
+            sum += (uint64_t)(int64_t)arr[i];
+            xr  ^= (uint64_t)(uint32_t)arr[i];
+            mix += key_mix(arr[i]);
+        }
+        poly = mulmod61(poly, poly_block(arr + b, e - b));
+    }
+    key_sum ks = { (uint64_t)n, sum, xr, mix, poly };
+    return ks;
+}
+
+static int key_sum_equal(key_sum a, key_sum b) {
+    return a.count == b.count && a.sum == b.sum && a.xr == b.xr &&
+           a.mix == b.mix && a.poly == b.poly;
+}
+
+/* ============================
+   Check selection
+   ============================ */
+/* arr[k] is the k-th smallest: nothing greater before, nothing smaller after */
+static int is_partitioned(const int *arr, size_t n, size_t k) {
+    for (size_t i = 0; i < k; i++)
+        if (arr[i] > arr[k])
+            return 0;
+    for (size_t i = k + 1; i < n; i++)
+        if (arr[i] < arr[k])
+            return 0;
+    return 1;
+}
+
 /* ============================
    Timing helper
    ============================ */
@@ -90,14 +462,523 @@ void make_quasi_sorted(int *arr, int64_t n, unsigned int seed) {
     }
 }
 
+/* ============================
+   Benchmark harness (--warmup, --reps)
+   ============================ */
+#ifndef GIT_HASH
+#define GIT_HASH "unknown"
+#endif
+#ifndef BUILD_FLAGS
+#define BUILD_FLAGS "unknown"
+#endif
+
+#define RESULTS_CSV "results.csv"
+
+typedef struct {
+    double min, median, p95, stddev;
+} bench_stats;
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Summary of r timings (sorted in place); p95 is the nearest rank */
+static bench_stats bench_summary(double *t, int r) {
+    qsort(t, (size_t)r, sizeof(double), compare_doubles);
+
+    double mean = 0.0, var = 0.0;
+    for (int i = 0; i < r; i++) mean += t[i];
+    mean /= r;
+    for (int i = 0; i < r; i++) var += (t[i] - mean) * (t[i] - mean);
+
+    bench_stats s;
+    s.min    = t[0];
+    s.median = (r % 2) ? t[r / 2] : 0.5 * (t[r / 2 - 1] + t[r / 2]);
+    s.p95    = t[(int)ceil(0.95 * r) - 1];
+    s.stddev = (r > 1) ? sqrt(var / (r - 1)) : 0.0;
+    return s;
+}
+
+/* Median time plus spread and throughput on stdout */
+static void print_stats(int64_t n, int warmup, int reps, bench_stats s) {
+    double rate = (s.median > 0.0) ? (double)n / s.median : 0.0;
+
+    printf("time = %.6f s\n", s.median);
+    if (reps > 1)
+        printf("reps = %d (+%d warmup): min %.6f s, p95 %.6f s, stddev %.6f s\n",
+               reps, warmup, s.min, s.p95, s.stddev);
+    printf("rate = %.0f keys/s, %.1f MB/s\n", rate, rate * sizeof(int) / 1e6);
+}
+
+/* "model name" from /proc/cpuinfo */
+static void cpu_model(char *buf, size_t len) {
+    snprintf(buf, len, "unknown");
+
+    FILE *fp = fopen("/proc/cpuinfo", "r");
+    if (!fp) return;
+
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        char *v = strchr(line, ':');
+        if (strncmp(line, "model name", 10) == 0 && v) {
+            v += 1 + strspn(v + 1, " \t");
+            v[strcspn(v, "\n")] = '\0';
+            snprintf(buf, len, "%s", v);
+            break;
+        }
+    }
+    fclose(fp);
+}
+
+static void csv_quoted(FILE *fp, const char *s) {
+    fputc('"', fp);
+    for (; *s; s++) {
+        if (*s == '"') fputc('"', fp);
+        fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+/* One row of results.csv, the file shared by all five programs;
+   program-specific settings go to params as key=value;key=value */
+static void write_result(const char *program, int64_t n, const char *pattern,
+                         int threads, int processes, int warmup, int reps,
+                         bench_stats s, int ok, const char *params) {
+    FILE *fp = fopen(RESULTS_CSV, "a");
+    if (!fp) {
+        fprintf(stderr, "Error opening %s\n", RESULTS_CSV);
+        return;
+    }
+
+    if (ftell(fp) == 0)
+        fprintf(fp, "program,n,pattern,threads,processes,warmup,reps,"
+                    "min,median,p95,stddev,keys_per_s,bytes_per_s,sorted,"
+                    "params,git,compiler,flags,cpu\n");
+
+    double rate = (s.median > 0.0) ? (double)n / s.median : 0.0;
+    char cpu[256];
+    cpu_model(cpu, sizeof(cpu));
+
+    fprintf(fp, "%s,%" PRId64 ",%s,%d,%d,%d,%d,%.6f,%.6f,%.6f,%.6f,%.0f,%.0f,%s,",
+            program, n, pattern, threads, processes, warmup, reps,
+            s.min, s.median, s.p95, s.stddev, rate, rate * sizeof(int),
+            ok ? "yes" : "no");
+    csv_quoted(fp, params);
+    fputc(',', fp);
+    csv_quoted(fp, GIT_HASH);
+    fputc(',', fp);
+    csv_quoted(fp, __VERSION__);
+    fputc(',', fp);
+    csv_quoted(fp, BUILD_FLAGS);
+    fputc(',', fp);
+    csv_quoted(fp, cpu);
+    fputc('\n', fp);
+
+    fclose(fp);
+}
+
+/* ============================
+   Phase timers (--phases, --perf)
+   ============================ */
+/* Named spans of a run; with --perf every span also reads cycles, LLC
+   misses and branch misses (perf_event, user space only) */
+enum { PH_GENERATE, PH_SORT, PH_VERIFY, PH_COUNT };
+
+static const char *phase_name[PH_COUNT] = { "generate", "sort", "verify" };
+
+#define PERF_COUNT 3
+static const char *perf_name[PERF_COUNT] = { "cycles", "llc-miss", "br-miss" };
+static int perf_fd[PERF_COUNT] = { -1, -1, -1 };
+
+static double   phase_time[PH_COUNT];
+static double   phase_t0[PH_COUNT];
+static int      phase_used[PH_COUNT];
+static uint64_t phase_ctr[PH_COUNT][PERF_COUNT];
+static uint64_t phase_c0[PH_COUNT][PERF_COUNT];
+
+/* 1/reps inside timed repetitions and 0 in warmups, so the sort phase
+   is reported per run */
+static double phase_weight = 1.0;
+
+static int perf_open_one(int i) {
+    static const uint64_t config[PERF_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.size = sizeof(a);
+    a.type = PERF_TYPE_HARDWARE;
+    a.config = config[i];
+    a.exclude_kernel = 1;
+    a.exclude_hv = 1;
+
+    return (int)syscall(__NR_perf_event_open, &a, 0, -1, -1, 0);
+}
+
+static void perf_open(void) {
+    for (int i = 0; i < PERF_COUNT; i++)
+        perf_fd[i] = perf_open_one(i);
+}
+
+static int perf_available(void) {
+    return perf_fd[0] >= 0 && perf_fd[1] >= 0 && perf_fd[2] >= 0;
+}
+
+static void perf_read(uint64_t *v) {
+    for (int i = 0; i < PERF_COUNT; i++)
+        if (perf_fd[i] < 0 || read(perf_fd[i], &v[i], sizeof(v[i])) != sizeof(v[i]))
+            v[i] = 0;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void phase_begin(int ph) {
+    perf_read(phase_c0[ph]);
+    phase_t0[ph] = now_seconds();
+}
+
+static void phase_end(int ph) {
+    double t = now_seconds();
+    uint64_t c[PERF_COUNT];
+    perf_read(c);
+
+    phase_used[ph] = 1;
+    phase_time[ph] += (t - phase_t0[ph]) * phase_weight;
+    for (int i = 0; i < PERF_COUNT; i++)
+        phase_ctr[ph][i] += (uint64_t)((double)(c[i] - phase_c0[ph][i]) * phase_weight);
+}
+
+static void phase_report(int perf) {
+    int have = perf_available();
+
+    printf("phases (s):\n");
+    for (int ph = 0; ph < PH_COUNT; ph++) {
+        if (!phase_used[ph]) continue;
+        printf("  %-10s %.6f", phase_name[ph], phase_time[ph]);
+        if (perf && have)
+            for (int i = 0; i < PERF_COUNT; i++)
+                printf("  %s %.3e", perf_name[i], (double)phase_ctr[ph][i]);
+        printf("\n");
+    }
+    if (perf && !have)
+        printf("  perf counters unavailable (perf_event_open failed)\n");
+}
+
+/* ============================
+   Top-k / percentile run
+   ============================ */
+/* Times the partial sort (mode "topk") or selection (mode "nth") of
+   arr, then a full quicksort of the same input for comparison. */
+static int run_select(int *arr, int64_t n, const char *pattern,
+                      const char *mode, int64_t k) {
+    int *copy = buf_alloc(n * sizeof(int));
+    if (!copy) {
+        fprintf(stderr, "Error allocating memory\n");
+        return EXIT_FAILURE;
+    }
+    memcpy(copy, arr, n * sizeof(int));
+
+    struct timespec t_start, t_end;
+    int ok;
+
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    if (strcmp(mode, "topk") == 0)
+        partial_sort(arr, (int)n, (int)k);
+    else
+        select_nth(arr, 0, (int)n - 1, (int)k);
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+    double t = elapsed_seconds(t_start, t_end);
+
+    if (strcmp(mode, "topk") == 0)
+        ok = is_sorted(arr, (size_t)k) && is_partitioned(arr, (size_t)n, (size_t)k - 1);
+    else
+        ok = is_partitioned(arr, (size_t)n, (size_t)k);
+
+    int64_t last = (strcmp(mode, "topk") == 0) ? k - 1 : k;
+    int value = arr[last];
+
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    quicksort(copy, 0, (int)n - 1);
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+    double t_full = elapsed_seconds(t_start, t_end);
+
+    ok = ok && is_sorted(copy, (size_t)n) && copy[last] == value;
+
+    printf("QuickSort Sequential (%s)\n", mode);
+    printf("n = %" PRId64 "\n", n);
+    printf("pattern = %s\n", pattern);
+    printf("k = %" PRId64 "\n", k);
+    printf("value = %d\n", value);
+    printf("time = %.6f s\n", t);
+    printf("full sort time = %.6f s\n", t_full);
+    printf("sorted = %s\n\n", ok ? "yes" : "no");
+
+    char params[128];
+    snprintf(params, sizeof(params), "mode=%s;k=%" PRId64 ";value=%d;full_time=%.6f",
+             mode, k, value, t_full);
+    write_result("quicksort_seq", n, pattern, 1, 1, 0, 1, bench_summary(&t, 1), ok, params);
+
+    free(copy);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* ============================
+   Stable sort (--stable)
+   ============================ */
+/* Records of a key and its input position. Only keys are compared; the
+   sequence number is the payload that shows whether equal keys kept
+   their input order. */
+typedef struct {
+    int key;
+    int seq;
+} rec;
+
+#define REC_RUN 32   /* runs sorted by insertion before the merge passes */
+
+/* strict > so equal keys never pass each other */
+static void rec_insertion(rec *a, int64_t lo, int64_t hi) {
+    for (int64_t i = lo + 1; i < hi; i++) {
+        rec x = a[i];
+        int64_t j = i;
+        while (j > lo && a[j - 1].key > x.key) {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = x;
+    }
+}
+
+/* Merges a[0..na) and b[0..nb) into out; ties take a, the earlier run */
+static void rec_merge(const rec *a, int64_t na, const rec *b, int64_t nb, rec *out) {
+    int64_t i = 0, j = 0, k = 0;
+    while (i < na && j < nb)
+        out[k++] = (a[i].key <= b[j].key) ? a[i++] : b[j++];
+    while (i < na) out[k++] = a[i++];
+    while (j < nb) out[k++] = b[j++];
+}
+
+/* Bottom-up stable mergesort of a[0..n), ping-ponging with buf */
+static void rec_mergesort(rec *a, int64_t n, rec *buf) {
+    for (int64_t lo = 0; lo < n; lo += REC_RUN)
+        rec_insertion(a, lo, (lo + REC_RUN < n) ? lo + REC_RUN : n);
+
+    rec *src = a, *dst = buf;
+    for (int64_t w = REC_RUN; w < n; w *= 2) {
+        for (int64_t lo = 0; lo < n; lo += 2 * w) {
+            int64_t mid = (lo + w < n) ? lo + w : n;
+            int64_t hi  = (lo + 2 * w < n) ? lo + 2 * w : n;
+            rec_merge(src + lo, mid - lo, src + mid, hi - mid, dst + lo);
+        }
+        rec *t = src; src = dst; dst = t;
+    }
+    if (src != a)
+        memcpy(a, src, (size_t)n * sizeof(rec));
+}
+
+/* Checksum of the records: a key that moves without its sequence
+   number, or a lost or repeated record, changes pair or seq_sum */
+typedef struct {
+    uint64_t count, seq_sum, pair;
+} rec_sum;
+
+static inline uint64_t rec_pair(rec r) {
+    return key_mix(r.key) * (2 * (uint64_t)(uint32_t)r.seq + 1);
+}
+
+static int rec_sum_equal(rec_sum a, rec_sum b) {
+    return a.count == b.count && a.seq_sum == b.seq_sum && a.pair == b.pair;
+}
+
+static rec_sum rec_sum_of(const rec *a, int64_t n) {
+    uint64_t seq_sum = 0, pair = 0;
+    for (int64_t i = 0; i < n; i++) {
+        seq_sum += (uint64_t)(uint32_t)a[i].seq;
+        pair    += rec_pair(a[i]);
+    }
+    rec_sum rs = { (uint64_t)n, seq_sum, pair };
+    return rs;
+}
+
+/* Sorted by key and, among equal keys, by sequence number */
+static int rec_stable(const rec *a, int64_t n) {
+    for (int64_t i = 1; i < n; i++)
+        if (a[i - 1].key > a[i].key ||
+            (a[i - 1].key == a[i].key && a[i - 1].seq >= a[i].seq))
+            return 0;
+    return 1;
+}
+
+/* The keys become records {key, input position} sorted with the stable
+   mergesort; the keys alone are also sorted once by quicksort as the
+   unstable reference */
+static int run_stable(const int *keys, int64_t n, const char *pattern,
+                      int warmup, int reps, int phases, int perf) {
+    rec *a    = buf_alloc(n * sizeof(rec));
+    rec *buf  = buf_alloc(n * sizeof(rec));
+    rec *orig = buf_alloc(n * sizeof(rec));
+    int *tmp  = buf_alloc(n * sizeof(int));
+    double *times = malloc((size_t)reps * sizeof(double));
+    if (!a || !buf || !orig || !tmp || !times) {
+        fprintf(stderr, "Error allocating memory\n");
+        return EXIT_FAILURE;
+    }
+
+    for (int64_t i = 0; i < n; i++)
+        orig[i] = (rec){ keys[i], (int)i };
+    buf_prefault(buf, n * sizeof(rec));
+
+    phase_begin(PH_VERIFY);
+    rec_sum in_sum = rec_sum_of(orig, n);
+    phase_end(PH_VERIFY);
+
+    struct timespec t_start, t_end;
+
+    for (int it = 0; it < warmup + reps; it++) {
+        memcpy(a, orig, n * sizeof(rec));
+        phase_weight = (it >= warmup) ? 1.0 / reps : 0.0;
+
+        clock_gettime(CLOCK_MONOTONIC, &t_start);
+        phase_begin(PH_SORT);
+        rec_mergesort(a, n, buf);
+        phase_end(PH_SORT);
+        clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+        if (it >= warmup)
+            times[it - warmup] = elapsed_seconds(t_start, t_end);
+    }
+    phase_weight = 1.0;
+
+    memcpy(tmp, keys, n * sizeof(int));
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    quicksort(tmp, 0, (int)n - 1);
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+    double t_unstable = elapsed_seconds(t_start, t_end);
+
+    phase_begin(PH_VERIFY);
+    int ok = rec_stable(a, n) && rec_sum_equal(in_sum, rec_sum_of(a, n));
+    phase_end(PH_VERIFY);
+
+    bench_stats st = bench_summary(times, reps);
+
+    printf("QuickSort Sequential (stable)\n");
+    printf("n = %" PRId64 "\n", n);
+    printf("pattern = %s\n", pattern);
+    printf("strategy = stable mergesort (key + seq records)\n");
+    if (hugepages)
+        printf("pages = %s\n", page_mode());
+    print_stats(n, warmup, reps, st);
+    printf("unstable time = %.6f s (quicksort, keys only), stable cost %.2fx\n",
+           t_unstable, (t_unstable > 0.0) ? st.median / t_unstable : 0.0);
+    if (phases)
+        phase_report(perf);
+    printf("sorted = %s\n\n", ok ? "yes" : "no");
+
+    char params[128];
+    snprintf(params, sizeof(params), "strategy=stable;unstable=%.6f%s", t_unstable,
+             hugepages ? ";pages=huge" : "");
+    write_result("quicksort_seq", n, pattern, 1, 1, warmup, reps, st, ok, params);
+
+    free(times);
+    free(tmp);
+    free(orig);
+    free(buf);
+    free(a);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* ============================
+   Command-line options (--name=value)
+   ============================ */
+static int split_args(int argc, char **argv) {
+    /* moves positional arguments to the front, returns their count */
+    int k = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            char *tmp = argv[i];
+            memmove(&argv[k + 1], &argv[k], (size_t)(i - k) * sizeof(char *));
+            argv[k++] = tmp;
+        }
+    }
+    return k;
+}
+
+static const char *get_opt(int argc, char **argv, const char *name) {
+    size_t len = strlen(name);
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) continue;
+        if (strncmp(argv[i] + 2, name, len) != 0) continue;
+        if (argv[i][2 + len] == '=') return argv[i] + 3 + len;
+        if (argv[i][2 + len] == '\0') return "";
+    }
+    return NULL;
+}
+
+/* ============================
+   Binary keys: mmap input
+   ============================ */
+/* Maps the first n int32 keys of a raw binary file as a private
+   (copy-on-write) mapping, so the sort runs in place without
+   touching the file. */
+static int *map_keys(const char *path, int64_t n, size_t *map_len) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error opening %s\n", path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (int64_t)st.st_size < n * (int64_t)sizeof(int)) {
+        fprintf(stderr, "Error: %s holds fewer than %" PRId64 " keys\n", path, n);
+        close(fd);
+        return NULL;
+    }
+
+    *map_len = (size_t)n * sizeof(int);
+    void *p = mmap(NULL, *map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (p == MAP_FAILED) {
+        fprintf(stderr, "Error mapping %s\n", path);
+        return NULL;
+    }
+
+    madvise(p, *map_len, MADV_SEQUENTIAL);
+    return (int *)p;
+}
+
+/* ============================
+   Binary keys: output
+   ============================ */
+static int write_keys(const char *path, const int *arr, int64_t n) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Error opening %s\n", path);
+        return 0;
+    }
+    size_t w = fwrite(arr, sizeof(int), (size_t)n, fp);
+    fclose(fp);
+    return w == (size_t)n;
+}
+
 /* ============================
             MAIN
    ============================ */
 int main(int argc, char **argv) {
 
-    if (argc < 2) {
+    int npos = split_args(argc, argv);
+
+    if (npos < 2) {
         fprintf(stderr,
-        "Usage: %s <n> [pattern=random|quasi|desc] [seed]\n", argv[0]);
+        "Usage: %s <n> [pattern=random|quasi|desc] [seed]"
+        " [--input=keys.bin] [--output=sorted.bin]"
+        " [--topk=K | --percentile=P] [--adaptive] [--stable] [--hugepages]"
+        " [--warmup=W] [--reps=R] [--phases] [--perf]\n", argv[0]);
         return EXIT_FAILURE;
     }
 
@@ -108,66 +989,209 @@ int main(int argc, char **argv) {
     }
 
     const char *pattern = "random";
-    if (argc >= 3) pattern = argv[2];
+    if (npos >= 3) pattern = argv[2];
+
+    const char *input  = get_opt(argc, argv, "input");
+    const char *output = get_opt(argc, argv, "output");
+    if (input) pattern = "file";
+
+    hugepages = (get_opt(argc, argv, "hugepages") != NULL);
 
-    unsigned int seed = (argc >= 4)
+    /* W untimed warmup runs, then R timed repetitions on the same input */
+    const char *opt;
+    int warmup = (opt = get_opt(argc, argv, "warmup")) != NULL ? atoi(opt) : 0;
+    int reps   = (opt = get_opt(argc, argv, "reps"))   != NULL ? atoi(opt) : 1;
+    if (warmup < 0 || reps < 1) {
+        fprintf(stderr, "Error: --warmup must be >= 0 and --reps >= 1\n");
+        return EXIT_FAILURE;
+    }
+
+    /* Per-phase report; --perf adds hardware counters to it */
+    int perf   = (get_opt(argc, argv, "perf") != NULL);
+    int phases = perf || (get_opt(argc, argv, "phases") != NULL);
+    if (perf)
+        perf_open();
+
+    /* Top-k (k smallest, sorted) or percentile (single k-th key) */
+    const char *select_mode = NULL;
+    int64_t k = 0;
+    if ((opt = get_opt(argc, argv, "topk")) != NULL) {
+        select_mode = "topk";
+        k = atoll(opt);
+        if (k < 1 || k > n) {
+            fprintf(stderr, "Error: k must be in [1, n]\n");
+            return EXIT_FAILURE;
+        }
+    } else if ((opt = get_opt(argc, argv, "percentile")) != NULL) {
+        select_mode = "nth";
+        double p = atof(opt);
+        if (p < 0.0 || p > 100.0) {
+            fprintf(stderr, "Error: percentile must be in [0, 100]\n");
+            return EXIT_FAILURE;
+        }
+        k = (int64_t)(p / 100.0 * (double)(n - 1));
+    }
+
+    unsigned int seed = (npos >= 4)
                           ? (unsigned int)strtoul(argv[3], NULL, 10)
                           : (unsigned int)time(NULL);
 
     srand(seed);
 
-    int *arr = malloc(n * sizeof(int));
-    if (!arr) {
-        fprintf(stderr, "Error allocating memory\n");
-        return EXIT_FAILURE;
+    struct timespec t_start, t_end;
+    double t_io = 0.0;
+
+    int *arr = NULL;
+    size_t map_len = 0;
+
+    if (input) {
+
+        clock_gettime(CLOCK_MONOTONIC, &t_start);
+        arr = map_keys(input, n, &map_len);
+        if (!arr) return EXIT_FAILURE;
+
+        /* the mapping is private: one write per page takes the
+           copy-on-write fault here, so it is not charged to the sort */
+        volatile int *page = arr;
+        for (int64_t i = 0; i < n; i += 4096 / sizeof(int))
+            page[i] = page[i];
+        if (n > 0)
+            page[n - 1] = page[n - 1];
+
+        clock_gettime(CLOCK_MONOTONIC, &t_end);
+        t_io += elapsed_seconds(t_start, t_end);
+
+    } else {
+
+        arr = buf_alloc(n * sizeof(int));
+        if (!arr) {
+            fprintf(stderr, "Error allocating memory\n");
+            return EXIT_FAILURE;
+        }
+
+        phase_begin(PH_GENERATE);
+
+        if (strcmp(pattern, "quasi") == 0) {
+
+            make_quasi_sorted(arr, n, seed);
+
+        } else if (strcmp(pattern, "desc") == 0) {
+
+            for (int64_t i = 0; i < n; i++)
+                arr[i] = (int)(n - 1 - i);
+
+        } else { // random (default)
+
+            for (int64_t i = 0; i < n; i++)
+                arr[i] = rand() % 100000;
+        }
+
+        phase_end(PH_GENERATE);
     }
 
-    if (strcmp(pattern, "quasi") == 0) {
+    if (select_mode) {
+        int rc = run_select(arr, n, pattern, select_mode, k);
+        if (input) munmap(arr, map_len); else free(arr);
+        return rc;
+    }
 
-        make_quasi_sorted(arr, n, seed);
+    /* Stable mode: records sorted by key, equal keys in input order */
+    if (get_opt(argc, argv, "stable") != NULL) {
+        int rc = run_stable(arr, n, pattern, warmup, reps, phases, perf);
+        if (input) munmap(arr, map_len); else free(arr);
+        return rc;
+    }
 
-    } else if (strcmp(pattern, "desc") == 0) {
+    int adaptive = (get_opt(argc, argv, "adaptive") != NULL);
+    const char *strategy = "quicksort";
+    int64_t inv = 0, runs = 0;
 
-        for (int64_t i = 0; i < n; i++)
-            arr[i] = (int)(n - 1 - i);
+    /* scratch for the natural merge, faulted in outside the timer */
+    int *scratch = NULL;
+    if (adaptive && (scratch = buf_alloc(n * sizeof(int))) != NULL)
+        buf_prefault(scratch, n * sizeof(int));
 
-    } else { // random (default)
+    /* checksum of the input, compared with the sorted output */
+    phase_begin(PH_VERIFY);
+    key_sum in_sum = key_sum_of(arr, n);
+    phase_end(PH_VERIFY);
 
-        for (int64_t i = 0; i < n; i++)
-            arr[i] = rand() % 100000;
+    /* pristine input, restored before every run after the first */
+    int *orig = NULL;
+    if (warmup + reps > 1) {
+        orig = buf_alloc(n * sizeof(int));
+        if (!orig) {
+            fprintf(stderr, "Error allocating memory\n");
+            if (input) munmap(arr, map_len); else free(arr);
+            return EXIT_FAILURE;
+        }
+        memcpy(orig, arr, n * sizeof(int));
     }
 
-    struct timespec t_start, t_end;
-    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    double *times = malloc((size_t)reps * sizeof(double));
 
-    quicksort(arr, 0, (int)n - 1);
+    for (int it = 0; it < warmup + reps; it++) {
+        if (it > 0)
+            memcpy(arr, orig, n * sizeof(int));
+        phase_weight = (it >= warmup) ? 1.0 / reps : 0.0;
 
-    clock_gettime(CLOCK_MONOTONIC, &t_end);
+        clock_gettime(CLOCK_MONOTONIC, &t_start);
+        phase_begin(PH_SORT);
 
-    double t = elapsed_seconds(t_start, t_end);
-    int ok = is_sorted(arr, (size_t)n);
+        if (adaptive)
+            strategy = adaptive_sort(arr, n, scratch, &inv, &runs);
+        else
+            quicksort(arr, 0, (int)n - 1);
+
+        phase_end(PH_SORT);
+        clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+        if (it >= warmup)
+            times[it - warmup] = elapsed_seconds(t_start, t_end);
+    }
+
+    phase_weight = 1.0;
+    free(scratch);
+    free(orig);
+
+    bench_stats st = bench_summary(times, reps);
+    free(times);
+
+    phase_begin(PH_VERIFY);
+    int ok = is_sorted(arr, (size_t)n) && key_sum_equal(in_sum, key_sum_of(arr, n));
+    phase_end(PH_VERIFY);
+
+    int written = 1;
+    if (output) {
+        clock_gettime(CLOCK_MONOTONIC, &t_start);
+        written = write_keys(output, arr, n);
+        clock_gettime(CLOCK_MONOTONIC, &t_end);
+        t_io += elapsed_seconds(t_start, t_end);
+    }
 
     printf("QuickSort Sequential\n");
     printf("n = %" PRId64 "\n", n);
     printf("pattern = %s\n", pattern);
-    printf("time = %.6f s\n", t);
-    printf("sorted = %s\n\n", ok ? "yes" : "no");
-
-    FILE *fp = fopen("results_seq.csv", "a");
-    if (!fp) {
-        fprintf(stderr, "Error opening results_seq.csv\n");
-        free(arr);
-        return EXIT_FAILURE;
+    if (adaptive) {
+        printf("inversions = %" PRId64 "\n", inv);
+        printf("runs = %" PRId64 "\n", runs);
     }
+    printf("strategy = %s\n", strategy);
+    if (hugepages)
+        printf("pages = %s\n", page_mode());
+    print_stats(n, warmup, reps, st);
+    if (input || output)
+        printf("io time = %.6f s\n", t_io);
+    if (phases)
+        phase_report(perf);
+    printf("sorted = %s\n\n", ok ? "yes" : "no");
 
-    if (ftell(fp) == 0)
-        fprintf(fp, "n,pattern,time,sorted\n");
+    char params[128];
+    snprintf(params, sizeof(params), "strategy=%s%s", strategy,
+             hugepages ? ";pages=huge" : "");
+    write_result("quicksort_seq", n, pattern, 1, 1, warmup, reps, st, ok, params);
 
-    fprintf(fp, "%" PRId64 ",%s,%.6f,%s\n",
-            n, pattern, t, ok ? "yes" : "no");
+    if (input) munmap(arr, map_len); else free(arr);
 
-    fclose(fp);
-    free(arr);
-
-    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    return (ok && written) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
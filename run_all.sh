@@ -4,18 +4,20 @@ set -e
 
 echo "=== Compiling programs ==="
 
-gcc -O2 quicksort_seq.c -o quicksort_seq
-mpicc -O2 mpi_mergesort.c   -o mpi_mergesort
-mpicc -O2 mpi_bitonicsort.c -o mpi_bitonicsort
-mpicc -O2 mpi_bucketsort.c  -o mpi_bucketsort
-gcc -O2 -fopenmp omp_quicksort.c -o omp_quicksort
+# git hash y flags quedan en cada fila de results.csv
+CFLAGS="-O2"
+GIT_HASH=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+META=(-DGIT_HASH="\"${GIT_HASH}\"" -DBUILD_FLAGS="\"${CFLAGS}\"")
+OMP_META=(-DGIT_HASH="\"${GIT_HASH}\"" -DBUILD_FLAGS="\"${CFLAGS} -fopenmp\"")
+
+gcc $CFLAGS "${META[@]}" quicksort_seq.c -o quicksort_seq -lm
+mpicc $CFLAGS "${META[@]}" mpi_mergesort.c   -o mpi_mergesort -lm
+mpicc $CFLAGS "${META[@]}" mpi_bitonicsort.c -o mpi_bitonicsort -lm
+mpicc $CFLAGS "${META[@]}" mpi_bucketsort.c  -o mpi_bucketsort -lm
+gcc $CFLAGS -fopenmp "${OMP_META[@]}" omp_quicksort.c -o omp_quicksort -lm
 
 echo "=== Deleting previous CSV files ==="
-rm -f results_seq.csv \
-      results_mpi_mergesort.csv \
-      results_mpi_bitonic.csv \
-      results_mpi_bucketsort.csv \
-      results_omp_quicksort.csv
+rm -f results.csv
 
 # Tamaños de problema y patrones a probar
 NS=("1000000" "2000000" "3000000" "4000000" "5000000" "6000000" "7000000" "8000000" "9000000" "10000000" "20000000")
@@ -27,12 +29,34 @@ MPI_PROCS=("1" "2" "4" "8")
 # Hilos para OpenMP
 OMP_THREADS=("1" "2" "4" "8")
 
+# Corridas de calentamiento y repeticiones medidas por configuración
+BENCH=(--warmup=1 --reps=5 --phases)
+
+# k para top-k frente a ordenamiento completo
+TOPK_N="10000000"
+TOPK_KS=("10" "1000" "1000000")
+
+# Modo servicio: muchos ordenamientos medianos en un solo lanzamiento
+SERVE_N="200000"
+SERVE_JOBS="50"
+
+# Lotes de arreglos pequeños: tamaños de segmento LO:HI
+SEG_N="4000000"
+SEG_SIZES=("1:16" "16:256" "100:5000")
+
+# desc con pivote fijo es cuadrático (y con n grande la recursión de tasks
+# desborda la pila): tamaño reducido para comparar motores
+DESC_N="20000"
+
+# Checkpoint en los bordes de fase (los programas MPI)
+CKPT_DIR="ckpt"
+
 echo
 echo "=== 1) Sequential QuickSort ==="
 for n in "${NS[@]}"; do
   for pat in "${PATTERNS[@]}"; do
     echo "Seq: n=${n}, pattern=${pat}"
-    ./quicksort_seq "$n" "$pat"
+    ./quicksort_seq "$n" "$pat" "${BENCH[@]}"
   done
 done
 
@@ -42,7 +66,7 @@ for p in "${MPI_PROCS[@]}"; do
   for n in "${NS[@]}"; do
     for pat in "${PATTERNS[@]}"; do
       echo "MPI MergeSort: procs=${p}, n=${n}, pattern=${pat}"
-      mpirun -np "$p" ./mpi_mergesort "$n" "$pat"
+      mpirun -np "$p" ./mpi_mergesort "$n" "$pat" "${BENCH[@]}"
     done
   done
 done
@@ -53,7 +77,7 @@ for p in "${MPI_PROCS[@]}"; do
   for n in "${NS[@]}"; do
     for pat in "${PATTERNS[@]}"; do
       echo "MPI Bitonic: procs=${p}, n=${n}, pattern=${pat}"
-      mpirun -np "$p" ./mpi_bitonicsort "$n" "$pat"
+      mpirun -np "$p" ./mpi_bitonicsort "$n" "$pat" "${BENCH[@]}"
     done
   done
 done
@@ -64,7 +88,7 @@ for p in "${MPI_PROCS[@]}"; do
   for n in "${NS[@]}"; do
     for pat in "${PATTERNS[@]}"; do
       echo "MPI Bucket: procs=${p}, n=${n}, pattern=${pat}"
-      mpirun -np "$p" ./mpi_bucketsort "$n" "$pat"
+      mpirun -np "$p" ./mpi_bucketsort "$n" "$pat" "${BENCH[@]}"
     done
   done
 done
@@ -73,15 +97,118 @@ echo
 echo "=== 5) OpenMP QuickSort ==="
 for t in "${OMP_THREADS[@]}"; do
   export OMP_NUM_THREADS="$t"
+  # calibra una vez por número de hilos; las corridas siguientes usan el perfil
+  ./omp_quicksort "${NS[0]}" random --tune > /dev/null
   for n in "${NS[@]}"; do
     for pat in "${PATTERNS[@]}"; do
       echo "OpenMP QuickSort: threads=${t}, n=${n}, pattern=${pat}"
-      ./omp_quicksort "$n" "$pat"
+      ./omp_quicksort "$n" "$pat" "${BENCH[@]}"
+    done
+  done
+done
+
+echo
+echo "=== 6) Top-k vs full sort ==="
+for k in "${TOPK_KS[@]}"; do
+  for pat in "${PATTERNS[@]}"; do
+    echo "Top-k: k=${k}, n=${TOPK_N}, pattern=${pat}"
+    ./quicksort_seq "$TOPK_N" "$pat" --topk="$k"
+    for t in "${OMP_THREADS[@]}"; do
+      OMP_NUM_THREADS="$t" ./omp_quicksort "$TOPK_N" "$pat" --topk="$k"
+    done
+    for p in "${MPI_PROCS[@]}"; do
+      mpirun -np "$p" ./mpi_bucketsort "$TOPK_N" "$pat" --topk="$k"
     done
   done
 done
 
+echo
+echo "=== 7) Adaptive front end (--adaptive) ==="
+for n in "${NS[@]}"; do
+  for pat in random quasi desc; do
+    echo "Adaptive: n=${n}, pattern=${pat}"
+    ./quicksort_seq "$n" "$pat" --adaptive "${BENCH[@]}"
+    for t in "${OMP_THREADS[@]}"; do
+      OMP_NUM_THREADS="$t" ./omp_quicksort "$n" "$pat" --adaptive "${BENCH[@]}"
+    done
+  done
+done
+
+echo
+echo "=== 8) Service mode (--serve) ==="
+JOBS_FILE=$(mktemp)
+for i in $(seq 1 "$SERVE_JOBS"); do
+  echo "$SERVE_N random $i" >> "$JOBS_FILE"
+done
+for t in "${OMP_THREADS[@]}"; do
+  OMP_NUM_THREADS="$t" ./omp_quicksort --serve="$JOBS_FILE" | tail -3
+done
+for p in "${MPI_PROCS[@]}"; do
+  mpirun -np "$p" ./mpi_mergesort   --serve="$JOBS_FILE" | tail -3
+  mpirun -np "$p" ./mpi_bitonicsort --serve="$JOBS_FILE" | tail -3
+  mpirun -np "$p" ./mpi_bucketsort  --serve="$JOBS_FILE" | tail -3
+done
+rm -f "$JOBS_FILE"
+
+echo
+echo "=== 9) Batched small arrays (--segments) ==="
+for seg in "${SEG_SIZES[@]}"; do
+  echo "Segments: n=${SEG_N}, sizes=${seg}"
+  for t in "${OMP_THREADS[@]}"; do
+    OMP_NUM_THREADS="$t" ./omp_quicksort "$SEG_N" random --segments="$seg" "${BENCH[@]}"
+  done
+  for p in "${MPI_PROCS[@]}"; do
+    mpirun -np "$p" ./mpi_bucketsort "$SEG_N" random --segments="$seg" "${BENCH[@]}"
+  done
+done
+
+echo
+echo "=== 10) Multiway mergesort vs task quicksort (--engine) ==="
+for t in "${OMP_THREADS[@]}"; do
+  export OMP_NUM_THREADS="$t"
+  for n in "${NS[@]}"; do
+    for pat in random quasi; do
+      echo "Engines: threads=${t}, n=${n}, pattern=${pat}"
+      ./omp_quicksort "$n" "$pat" --engine=tasks "${BENCH[@]}"
+      ./omp_quicksort "$n" "$pat" --engine=merge "${BENCH[@]}"
+    done
+  done
+  echo "Engines: threads=${t}, n=${DESC_N}, pattern=desc"
+  ./omp_quicksort "$DESC_N" desc --engine=tasks "${BENCH[@]}"
+  ./omp_quicksort "$DESC_N" desc --engine=merge "${BENCH[@]}"
+done
+
+echo
+echo "=== 11) Stable mode (--stable) vs unstable ==="
+for n in "${NS[@]}"; do
+  for pat in "${PATTERNS[@]}"; do
+    echo "Stable: n=${n}, pattern=${pat}"
+    ./quicksort_seq "$n" "$pat" --stable "${BENCH[@]}"
+    for t in "${OMP_THREADS[@]}"; do
+      OMP_NUM_THREADS="$t" ./omp_quicksort "$n" "$pat" --stable "${BENCH[@]}"
+    done
+    for p in "${MPI_PROCS[@]}"; do
+      mpirun -np "$p" ./mpi_bucketsort "$n" "$pat" --stable "${BENCH[@]}"
+    done
+  done
+done
+
+echo
+echo "=== 12) Checkpoint cost and restart (--checkpoint) ==="
+mkdir -p "$CKPT_DIR"
+for n in "${NS[@]}"; do
+  for p in "${MPI_PROCS[@]}"; do
+    echo "Checkpoint: n=${n}, procs=${p}"
+    mpirun -np "$p" ./mpi_bitonicsort "$n" random --checkpoint="$CKPT_DIR" "${BENCH[@]}"
+    mpirun -np "$p" ./mpi_mergesort "$n" random --checkpoint="$CKPT_DIR" "${BENCH[@]}"
+    mpirun -np "$p" ./mpi_bucketsort "$n" random --checkpoint="$CKPT_DIR" "${BENCH[@]}"
+    # caída simulada tras el intercambio y reinicio desde el checkpoint
+    mpirun -np "$p" ./mpi_bucketsort "$n" random --checkpoint="$CKPT_DIR" --fail-after=1 || true
+    mpirun -np "$p" ./mpi_bucketsort "$n" random --checkpoint="$CKPT_DIR" --restart
+  done
+done
+
 echo
 echo "=== Experiments completed ==="
 echo "CSV files generated:"
-ls -1 results_*.csv
+ls -1 results*.csv